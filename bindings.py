@@ -52,6 +52,14 @@ move_origin.restype = c_uint8
 move_destination.restype = c_uint8
 move_kind.restype = c_int
 
+_move_see = lib.chess__move_see
+_move_see.argtypes = [c_void_p, c_void_p, POINTER(c_float)]
+_move_see.restype = c_float
+
+def move_see(game, move, values):
+    """Static exchange evaluation of move, values of king, queen, rook, bishop, knight and pawn"""
+    return _move_see(game, move, (c_float * 6)(*values))
+
 is_mated = lib.chess__game_mated
 is_checked = lib.chess__game_checked
 is_stalemated = lib.chess__game_stalemated
@@ -149,6 +157,28 @@ fullmoves.restype = c_uint32
 halfmoves.argtypes = [c_void_p]
 fullmoves.argtypes = [c_void_p]
 
+perft = lib.chess__game_perft
+perft.restype = c_uint64
+perft.argtypes = [c_void_p, c_uint32]
+
+_game_fen = lib.chess__game_fen
+_game_fen.argtypes = [c_void_p, c_char_p, c_uint32]
+_game_fen.restype = c_uint32
+
+def get_fen(game):
+    size = _game_fen(game, None, 0)
+    buf = create_string_buffer(size + 1)
+    _game_fen(game, buf, len(buf))
+    return buf.value.decode('utf-8')
+
+game_hash = lib.chess__game_hash
+game_hash.argtypes = [c_void_p]
+game_hash.restype = c_uint64
+
+repack_game = lib.chess__game_repack
+repack_game.argtypes = [c_void_p]
+repack_game.restype = c_void_p
+
 
 evaluate_game = lib.chess__game_evaluation
 game_advantage = lib.chess__game_advantage
@@ -180,6 +210,87 @@ create_random_agent.restype = c_void_p
 delete_random_agent.argtypes =[c_void_p]
 delete_weighted_agent.argtypes = [c_void_p]
 
+set_agent_threads = lib.chess__weighted_agent_set_threads
+set_agent_threads.argtypes = [c_void_p, c_uint32]
+
+class SearchFeature:
+    Quiescence = 0
+    NullMove = 1
+    LateMoveReductions = 2
+    Futility = 3
+    Razoring = 4
+    SeePruning = 5
+
+set_agent_feature = lib.chess__weighted_agent_set_feature
+set_agent_feature.argtypes = [c_void_p, c_int, c_bool]
+
+_agent_pv = lib.chess__weighted_agent_pv
+_agent_pv.argtypes = [c_void_p, c_char_p, c_uint32]
+_agent_pv.restype = c_uint32
+
+def get_agent_pv(agent):
+    buf = create_string_buffer(1024)
+    _agent_pv(agent, buf, len(buf))
+    return buf.value.decode('utf-8').split()
+
+class SearchStatistics(Structure):
+    _fields_ = [
+            ("nodes", c_uint64),
+            ("qnodes", c_uint64),
+            ("tt_probes", c_uint64),
+            ("tt_hits", c_uint64),
+            ("tt_cutoffs", c_uint64),
+            ("beta_cutoffs", c_uint64),
+            ("first_move_cutoffs", c_uint64),
+            ("time_ms", c_uint64),
+            ("depth", c_uint32),
+            ("seldepth", c_uint32),
+            ("branching_factor", c_float),
+            ("eval_probes", c_uint64),
+            ("eval_hits", c_uint64),
+            ("pawn_probes", c_uint64),
+            ("pawn_hits", c_uint64),
+            ("lazy_probes", c_uint64),
+            ("lazy_exits", c_uint64),
+            ]
+
+get_agent_stats = lib.chess__weighted_agent_stats
+get_agent_stats.argtypes = [c_void_p]
+get_agent_stats.restype = SearchStatistics
+
+_agent_stats_json = lib.chess__weighted_agent_stats_json
+_agent_stats_json.argtypes = [c_void_p, c_char_p, c_uint32]
+_agent_stats_json.restype = c_uint32
+
+def get_agent_stats_json(agent):
+    size = _agent_stats_json(agent, None, 0)
+    buf = create_string_buffer(size + 1)
+    _agent_stats_json(agent, buf, len(buf))
+    return buf.value.decode('utf-8')
+
+set_agent_log_stats = lib.chess__weighted_agent_log_stats
+set_agent_log_stats.argtypes = [c_void_p, c_bool]
+
+set_agent_eval_cache = lib.chess__weighted_agent_set_eval_cache
+set_agent_eval_cache.argtypes = [c_void_p, c_uint32]
+
+set_agent_pawn_hash = lib.chess__weighted_agent_set_pawn_hash
+set_agent_pawn_hash.argtypes = [c_void_p, c_uint32]
+
+set_agent_lazy_eval = lib.chess__weighted_agent_set_lazy_eval
+set_agent_lazy_eval.argtypes = [c_void_p, c_bool]
+
+ponder_start = lib.chess__ponder_start
+ponder_start.argtypes = [c_void_p, c_void_p]
+ponder_start.restype = c_void_p
+
+ponder_hit = lib.chess__ponder_hit
+ponder_hit.argtypes = [c_void_p, c_void_p]
+ponder_hit.restype = c_void_p
+
+ponder_stop = lib.chess__ponder_stop
+ponder_stop.argtypes = [c_void_p]
+
 DEFAULT_WEIGHTED_AGENT = create_weighted_agent()
 
 
@@ -14,6 +14,17 @@ app = Flask(__name__, static_folder="static", static_url_path="")
 global ACTIVE_GAME
 ACTIVE_GAME = None
 
+# Pondering: once the engine has moved, it keeps searching the reply
+# it expects, on the player's time
+PONDER = None
+LAST_ENGINE_MOVE = None
+
+def stop_pondering():
+    global PONDER
+    if PONDER:
+        chess.ponder_stop(PONDER)
+        PONDER = None
+
 def fetch_game_weights():
     return {}
     return {
@@ -151,6 +162,7 @@ def new_game():
         return "Failed to create a game: Bad FEN string", 400
     global ACTIVE_GAME
 
+    stop_pondering()
     if(ACTIVE_GAME):
         chess.delete_game(ACTIVE_GAME)
     ACTIVE_GAME = game
@@ -178,8 +190,14 @@ def create_move(move):
     if not MOVE: return "Failed to find move", 400
 
     
+    global PONDER
     chess.move(ACTIVE_GAME, MOVE)
 
+    # The engine's own move was just played, think on the player's time
+    if (fro, to, kind) == LAST_ENGINE_MOVE:
+        stop_pondering()
+        PONDER = chess.ponder_start(ACTIVE_GAME, chess.DEFAULT_WEIGHTED_AGENT)
+
     return "success"
 
 @app.route("/game/info")
@@ -191,9 +209,16 @@ def game_info():
 @app.route("/game/best_move")
 def game_best_move():
     # return "AA", 400
-    best_move = chess.get_agent_move(ACTIVE_GAME, chess.DEFAULT_WEIGHTED_AGENT)
+    global PONDER, LAST_ENGINE_MOVE
+    best_move = None
+    if PONDER:
+        best_move = chess.ponder_hit(PONDER, ACTIVE_GAME)
+        stop_pondering()
+    if not best_move:
+        best_move = chess.get_agent_move(ACTIVE_GAME, chess.DEFAULT_WEIGHTED_AGENT)
     best_move_dict = move_to_dict(best_move)
     chess.delete_move(best_move)
+    LAST_ENGINE_MOVE = (best_move_dict["from"], best_move_dict["to"], best_move_dict["kind"])
     return best_move_dict
 
 @app.route("/game/tune")
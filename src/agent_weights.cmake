@@ -0,0 +1,96 @@
+#
+# Turns an .agent file (see Weighted::encode) into a header of constexpr
+# weights, for the compiled evaluator in agents/static_weights.h
+#
+# cmake -DAGENT=<file.agent> -DOUTPUT=<header> -P agent_weights.cmake
+#
+# Every weight has to be given, the compiled evaluator has no defaults
+# to fall back on.
+#
+cmake_minimum_required(VERSION 3.23)
+
+set(STAGE_WEIGHTS
+  center_control check doubled_pawns isolated_pawns king_front_pawns
+  material mobility passed_pawns pawn_devel positioning protected_pieces
+  vulnerability)
+set(PIECE_WEIGHTS positions values)
+
+file(READ "${AGENT}" content)
+# Semicolons are list separators to cmake
+string(REPLACE "\r" "" content "${content}")
+string(REPLACE ";" "|" content "${content}")
+string(REPLACE "\n" ";" lines "${content}")
+# The members are declared in alphabetical order, like Weighted::encode writes them
+list(SORT lines)
+
+set(source "")
+set(initializers "")
+set(seen "")
+foreach(line IN LISTS lines)
+  if(line STREQUAL "")
+    continue()
+  endif()
+  if(NOT line MATCHES "^([a-z_]+)\\|([MP])\\|(.*)$")
+    message(FATAL_ERROR "${AGENT}: malformed line '${line}'")
+  endif()
+  set(name "${CMAKE_MATCH_1}")
+  set(type "${CMAKE_MATCH_2}")
+  string(REPLACE "," ";" values "${CMAKE_MATCH_3}")
+
+  if(type STREQUAL "M")
+    set(expected 3)
+    set(known ${STAGE_WEIGHTS})
+  else()
+    set(expected 6)
+    set(known ${PIECE_WEIGHTS})
+  endif()
+  if(NOT name IN_LIST known)
+    message(FATAL_ERROR "${AGENT}: unknown ${type} weight '${name}'")
+  endif()
+  list(LENGTH values count)
+  if(NOT count EQUAL expected)
+    message(FATAL_ERROR "${AGENT}: '${name}' needs ${expected} values, got ${count}")
+  endif()
+
+  set(literals "")
+  foreach(v IN LISTS values)
+    string(STRIP "${v}" v)
+    if(NOT v MATCHES "[.eE]")
+      set(v "${v}.0")
+    endif()
+    list(APPEND literals "${v}f")
+  endforeach()
+  list(JOIN literals ", " literals)
+
+  string(REPLACE "|" ";" raw "${line}")
+  string(APPEND source "    \"${raw}\\n\"\n")
+  string(APPEND initializers "    .${name} = {${literals}},\n")
+  list(APPEND seen ${name})
+endforeach()
+
+foreach(name IN LISTS STAGE_WEIGHTS PIECE_WEIGHTS)
+  if(NOT name IN_LIST seen)
+    message(FATAL_ERROR "${AGENT}: missing weight '${name}'")
+  endif()
+endforeach()
+
+get_filename_component(agent_name "${AGENT}" NAME)
+file(WRITE "${OUTPUT}.tmp"
+"#pragma once
+//
+// Generated from ${agent_name} by agent_weights.cmake, do not edit
+//
+namespace chess::agents::production {
+
+// The agent as text, for Weighted::decode
+inline constexpr const char *SOURCE =
+${source};
+
+inline constexpr StaticWeights WEIGHTS{
+${initializers}};
+
+}; // namespace chess::agents::production
+")
+# Only touch the header when it changed, it is included everywhere
+file(COPY_FILE "${OUTPUT}.tmp" "${OUTPUT}" ONLY_IF_DIFFERENT)
+file(REMOVE "${OUTPUT}.tmp")
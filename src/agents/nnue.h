@@ -0,0 +1,141 @@
+#pragma once
+
+//
+// The NNUE agent searches with an alpha-beta negamax (and a quiescence
+// search over captures), evaluating leaves with a neural network instead
+// of the hand written terms of the weighted agent.
+//
+// Every ply of the search owns an accumulator, the child's is derived
+// from the parent's with the pieces the move added and removed (see
+// nnue::update), so a leaf only pays for the small layers of the network.
+//
+
+#include "../agent.h"
+#include "../error.h"
+#include "../nnue.h"
+#include "../ordering.h"
+#include <memory>
+#include <string>
+
+namespace chess::agents {
+
+class Nnue : public chess::Agent {
+public:
+  std::shared_ptr<const nnue::Network> network;
+  int search_depth = 4;
+  // Nodes visited by the last search
+  mutable uint64_t nodes = 0;
+
+  // Without a network file, the agent only counts material
+  Nnue() : network(std::make_shared<const nnue::Network>(nnue::Network::material())) {}
+  explicit Nnue(const std::string &path)
+      : network(std::make_shared<const nnue::Network>(nnue::Network::load(path))) {}
+
+  Game::Move move(const Game &game) const override {
+    if (game.state != Game::State::WhiteToMove && game.state != Game::State::BlackToMove)
+      throw chess::Error("Tried to search a finished game");
+
+    Search search(*network, search_depth);
+    nnue::refresh(*network, game, search.stack[0]);
+    auto best = search.root(game);
+    nodes = search.nodes;
+    return best;
+  }
+
+private:
+  static constexpr int32_t MATE = 1000000;
+  static constexpr int32_t INFINITE = MATE + 1;
+  // Only used to order the moves
+  inline static const evaluators::PerPiece VALUES{0, 9, 5, 3, 3, 1};
+
+  struct Search {
+    const nnue::Network &net;
+    int depth;
+    std::vector<nnue::Accumulator> stack;
+    MoveOrdering ordering;
+    uint64_t nodes = 0;
+
+    Search(const nnue::Network &net, int depth)
+        : net(net), depth(depth), stack(depth + MoveOrdering::MAX_PLY + 1) {}
+
+    // Play the move on a copy of the game, bringing the child's accumulator up to date
+    Game play(const Game &game, const Game::Move &m, int ply) {
+      Game child = game;
+      child.deltas.clear();
+      child.make_move(m);
+      nnue::update(net, child, stack[ply], stack[ply + 1]);
+      nodes++;
+      return child;
+    }
+
+    // Score of a finished game, for the team that would be moving
+    static int32_t terminal(const Game &game, int ply) {
+      if (game.state == Game::State::Stalemate)
+        return 0;
+      // The team that just moved won
+      return -MATE + ply;
+    }
+
+    static bool finished(const Game &game) {
+      return game.state != Game::State::WhiteToMove && game.state != Game::State::BlackToMove;
+    }
+
+    Game::Move root(const Game &game) {
+      auto moves = game.movelist(game.current_active_team());
+      if (moves.empty())
+        throw chess::Error("No moves to search");
+      ordering.order(game, moves, 0, 0, VALUES);
+
+      auto best = moves[0];
+      int32_t alpha = -INFINITE;
+      for (auto &m : moves) {
+        auto child = play(game, m, 0);
+        auto score = finished(child) ? terminal(child, 1) : negamax(child, depth - 1, 1, -INFINITE, -alpha);
+        score = -score;
+        if (score > alpha) {
+          alpha = score;
+          best = m;
+        }
+      }
+      return best;
+    }
+
+    int32_t negamax(const Game &game, int depth, int ply, int32_t alpha, int32_t beta) {
+      if (depth <= 0 || ply + 1 >= (int)stack.size())
+        return quiesce(game, ply, alpha, beta);
+
+      auto moves = game.movelist(game.current_active_team());
+      ordering.order(game, moves, ply, 0, VALUES);
+      for (auto &m : moves) {
+        auto child = play(game, m, ply);
+        auto score = -(finished(child) ? terminal(child, ply + 1) : negamax(child, depth - 1, ply + 1, -beta, -alpha));
+        if (score >= beta) {
+          ordering.on_cutoff(m, ply, depth);
+          return beta;
+        }
+        alpha = std::max(alpha, score);
+      }
+      return alpha;
+    }
+
+    int32_t quiesce(const Game &game, int ply, int32_t alpha, int32_t beta) {
+      auto stand_pat = nnue::evaluate(net, stack[ply], game.current_active_team());
+      if (stand_pat >= beta || ply + 1 >= (int)stack.size())
+        return stand_pat;
+      alpha = std::max(alpha, stand_pat);
+
+      auto moves = game.movelist(game.current_active_team(), true);
+      MoveOrdering::order_tactical(game, moves, VALUES);
+      for (auto &m : moves) {
+        auto child = play(game, m, ply);
+        auto score = -(finished(child) ? terminal(child, ply + 1) : quiesce(child, ply + 1, -beta, -alpha));
+        if (score >= beta)
+          return beta;
+        alpha = std::max(alpha, score);
+      }
+      return alpha;
+    }
+  };
+};
+
+}; // namespace chess::agents
@@ -0,0 +1,258 @@
+#pragma once
+#include "../evaluate.h"
+#include "../pawns.h"
+#include "../score.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+
+//
+// Weights known at compile time
+//
+// The production agent's weights never change at runtime, so they are
+// compiled in from an .agent file (production.agent, or the PRODUCTION_AGENT
+// cmake option) by agent_weights.cmake. The evaluator is instantiated per
+// game stage, so every weight folds into an immediate and no term has to
+// pick its stage.
+//
+// Weighted::weightedsum evaluates the same terms in float (for training),
+// the two have to stay in step.
+//
+namespace chess::agents {
+
+struct StageWeights {
+  float opening;
+  float midgame;
+  float endgame;
+
+  template <Game::GameStage S> constexpr float at() const {
+    if constexpr (S == Game::GameStage::Opening)
+      return opening;
+    else if constexpr (S == Game::GameStage::MidGame)
+      return midgame;
+    else
+      return endgame;
+  }
+};
+
+// Same members as evaluators::PerPiece
+struct PieceWeights {
+  float king;
+  float queen;
+  float rook;
+  float bishop;
+  float knight;
+  float pawn;
+};
+
+// Declared in the (alphabetical) order of the .agent files
+struct StaticWeights {
+  StageWeights center_control;
+  StageWeights check;
+  StageWeights doubled_pawns;
+  StageWeights isolated_pawns;
+  StageWeights king_front_pawns;
+  StageWeights material;
+  StageWeights mobility;
+  StageWeights passed_pawns;
+  StageWeights pawn_devel;
+  StageWeights positioning;
+  PieceWeights positions;
+  StageWeights protected_pieces;
+  PieceWeights values;
+  StageWeights vulnerability;
+};
+
+//
+// Integer weights, which the search evaluates with (see score.h)
+//
+// Weights are fixed point, stage weights with WEIGHT_SHIFT fractional bits
+// and piece values and positions with PIECE_SHIFT. Terms are summed in 64
+// bits and only the difference between the teams is scaled back down.
+//
+constexpr int WEIGHT_SHIFT = 12;
+constexpr int PIECE_SHIFT = 8;
+
+constexpr int32_t quantize(float w, int shift = 0) {
+  float scaled = w * (float)(1 << shift);
+  return scaled >= 0 ? (int32_t)(scaled + 0.5f) : -(int32_t)(-scaled + 0.5f);
+}
+
+// Same members as evaluators::PerPiece
+struct PieceScores {
+  int32_t king;
+  int32_t queen;
+  int32_t rook;
+  int32_t bishop;
+  int32_t knight;
+  int32_t pawn;
+
+  constexpr bool operator==(const PieceScores &o) const = default;
+};
+
+// The weights of a single stage
+struct StageScores {
+  int32_t center_control;
+  int32_t check;
+  int32_t doubled_pawns;
+  int32_t isolated_pawns;
+  int32_t king_front_pawns;
+  int32_t material;
+  int32_t mobility;
+  int32_t passed_pawns;
+  int32_t pawn_devel;
+  int32_t positioning;
+  int32_t protected_pieces;
+  int32_t vulnerability;
+
+  constexpr bool operator==(const StageScores &o) const = default;
+};
+
+struct QuantizedWeights {
+  PieceScores positions;
+  PieceScores values;
+  // Indexed by Game::GameStage
+  std::array<StageScores, 3> stages;
+
+  constexpr bool operator==(const QuantizedWeights &o) const = default;
+};
+
+// Works on StaticWeights and on Weighted::EvaluatorWeights alike
+template <class Weights> constexpr QuantizedWeights quantize(const Weights &w) {
+  auto pieces = [](const auto &p) {
+    return PieceScores{quantize(p.king, PIECE_SHIFT), quantize(p.queen, PIECE_SHIFT),
+                       quantize(p.rook, PIECE_SHIFT), quantize(p.bishop, PIECE_SHIFT),
+                       quantize(p.knight, PIECE_SHIFT), quantize(p.pawn, PIECE_SHIFT)};
+  };
+  auto stage = [&](auto pick) {
+    auto q = [&](const auto &weight) { return quantize(pick(weight), WEIGHT_SHIFT); };
+    return StageScores{q(w.center_control), q(w.check), q(w.doubled_pawns), q(w.isolated_pawns),
+                       q(w.king_front_pawns), q(w.material), q(w.mobility), q(w.passed_pawns),
+                       q(w.pawn_devel), q(w.positioning), q(w.protected_pieces), q(w.vulnerability)};
+  };
+  return QuantizedWeights{
+      pieces(w.positions),
+      pieces(w.values),
+      {stage([](const auto &m) { return m.opening; }),
+       stage([](const auto &m) { return m.midgame; }),
+       stage([](const auto &m) { return m.endgame; })},
+  };
+}
+
+// Weighted sum of a team's terms, with SUM_SHIFT fractional bits
+// Weighted::weightedsum is the float version of the same sum
+constexpr int SUM_SHIFT = WEIGHT_SHIFT + PIECE_SHIFT;
+
+//
+// The sum is split in two tiers. The cheap terms only read the board, the
+// accumulators and the pawn structure, while the attack terms need the attack
+// maps of both teams (see EvalContext), which cost more than everything else
+// put together. A lazy evaluator only pays for the second tier when the first
+// one leaves the outcome in doubt
+//
+inline int64_t cheap_sum(const Game &game, Game::Team team, const PawnStructure &pawns,
+                         const QuantizedWeights &q, const StageScores &w) {
+  auto &pawn_terms = pawns.of(team);
+  // Already scaled by the piece weights
+  int64_t per_piece = (int64_t)evaluators::positioning(game, team, q.positions) * w.positioning +
+                      (int64_t)evaluators::material_advantage(game, team, q.values) * w.material;
+  int64_t plain = (int64_t)evaluators::mobility(game, team) * w.mobility +
+                  (int64_t)pawn_terms.development * w.pawn_devel +
+                  (int64_t)pawn_terms.king_front * w.king_front_pawns +
+                  (int64_t)pawn_terms.passed * w.passed_pawns -
+                  (int64_t)pawn_terms.isolated * w.isolated_pawns -
+                  (int64_t)pawn_terms.doubled * w.doubled_pawns;
+  return per_piece + plain * (1 << PIECE_SHIFT);
+}
+
+inline int64_t attack_sum(const evaluators::EvalContext &ctx, Game::Team team, const QuantizedWeights &q,
+                          const StageScores &w) {
+  int64_t per_piece = (int64_t)evaluators::vulnerability(ctx, team, q.values) * w.vulnerability +
+                      (int64_t)evaluators::covered_pieces(ctx, team, q.values) * w.protected_pieces;
+  int64_t plain = (int64_t)evaluators::check(ctx, team) * w.check +
+                  (int64_t)evaluators::center_control(ctx, team) * w.center_control;
+  return per_piece + plain * (1 << PIECE_SHIFT);
+}
+
+//
+// The margin a lazy evaluator gives the attack terms at a stage. They could
+// move the score by every piece on the board, this is what they typically
+// move it by: the most valuable piece (king aside) turning from attacked to
+// covered, a check and the whole center changing hands. A heuristic, taken
+// from the weights so that it follows them through training
+//
+inline Score lazy_margin(const QuantizedWeights &q, const StageScores &w) {
+  static const int64_t center_max =
+      std::accumulate(evaluators::center_ctrl_scores.begin(), evaluators::center_ctrl_scores.end(), 0);
+  auto abs = [](int32_t v) { return (int64_t)(v < 0 ? -v : v); };
+  int64_t piece = std::max({abs(q.values.queen), abs(q.values.rook), abs(q.values.bishop),
+                            abs(q.values.knight), abs(q.values.pawn)});
+  int64_t per_piece = piece * (abs(w.vulnerability) + abs(w.protected_pieces));
+  int64_t plain = 2 * abs(w.check) + center_max * abs(w.center_control);
+  return scores::clamp_eval((per_piece + plain * (1 << PIECE_SHIFT)) >> SUM_SHIFT);
+}
+
+inline int64_t fixed_sum(const evaluators::EvalContext &ctx, Game::Team team, const PawnStructure &pawns,
+                         const QuantizedWeights &q, const StageScores &w) {
+  return cheap_sum(ctx.game, team, pawns, q, w) + attack_sum(ctx, team, q, w);
+}
+
+// Divided rather than shifted, so that black's score is exactly the negation
+inline Score scale_sum(int64_t diff) { return scores::clamp_eval(diff / (1LL << SUM_SHIFT)); }
+
+// Score of a position with a team to move, for white
+inline Score fixed_score(const evaluators::EvalContext &ctx, const PawnStructure &pawns,
+                         const QuantizedWeights &q, const StageScores &w) {
+  return scale_sum(fixed_sum(ctx, Game::Team::White, pawns, q, w) - fixed_sum(ctx, Game::Team::Black, pawns, q, w));
+}
+
+// The first tier of fixed_score alone, for white
+inline Score cheap_score(const Game &game, const PawnStructure &pawns, const QuantizedWeights &q,
+                         const StageScores &w) {
+  return scale_sum(cheap_sum(game, Game::Team::White, pawns, q, w) -
+                   cheap_sum(game, Game::Team::Black, pawns, q, w));
+}
+
+//
+// The same evaluation with the weights known at compile time, every stage
+// gets its own instantiation so the weights fold into immediates
+//
+template <const StaticWeights &W> struct StaticEvaluator {
+  static constexpr QuantizedWeights Q = quantize(W);
+
+  template <Game::GameStage S>
+  static Score score(const evaluators::EvalContext &ctx, const PawnStructure &pawns) {
+    return fixed_score(ctx, pawns, Q, Q.stages[S]);
+  }
+
+  // NOTE: Only for positions with a team to move, see EvalContext
+  static Score score(const Game &game, const PawnStructure &pawns) {
+    evaluators::EvalContext ctx(game);
+    return at_stage(game.stage, [&]<Game::GameStage S>() { return score<S>(ctx, pawns); });
+  }
+
+  static Score cheap(const Game &game, const PawnStructure &pawns) {
+    return at_stage(game.stage, [&]<Game::GameStage S>() { return cheap_score(game, pawns, Q, Q.stages[S]); });
+  }
+
+private:
+  template <class F> static Score at_stage(Game::GameStage stage, F &&f) {
+    switch (stage) {
+    case Game::GameStage::Opening:
+      return f.template operator()<Game::GameStage::Opening>();
+    case Game::GameStage::MidGame:
+      return f.template operator()<Game::GameStage::MidGame>();
+    default:
+      return f.template operator()<Game::GameStage::Endgame>();
+    }
+  }
+};
+
+}; // namespace chess::agents
+
+#include "production_weights.h"
+
+namespace chess::agents {
+using ProductionEvaluator = StaticEvaluator<production::WEIGHTS>;
+}; // namespace chess::agents
@@ -6,6 +6,21 @@
 #include <map>
 #include <sstream>
 #include <fstream>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include "../transposition.h"
+#include "../evalcache.h"
+#include "../pawns.h"
+#include "./static_weights.h"
+#include "../ordering.h"
+#include "../pruning.h"
+#include "../stats.h"
+#include <cmath>
+#include <array>
+#include <chrono>
+#include <functional>
 //
 // The weighted agent takes the weighted sum of various features of the board
 // to construct a final score
@@ -32,8 +47,50 @@ namespace chess::agents
             evaluators::MultistageEvaluationWeight king_front_pawns{1, 1, 1};
             evaluators::MultistageEvaluationWeight center_control{1, 1, 1};
             evaluators::MultistageEvaluationWeight protected_pieces{1, 1, 1};
+            evaluators::MultistageEvaluationWeight passed_pawns{10, 30, 300};
+            // Penalties, subtracted from the sum
+            evaluators::MultistageEvaluationWeight isolated_pawns{5, 10, 50};
+            evaluators::MultistageEvaluationWeight doubled_pawns{5, 10, 50};
         } weights;
 
+        // The weights the search evaluates with (see quantize)
+        QuantizedWeights quantized() const
+        {
+            return quantize(weights);
+        }
+
+        // Whether the weights are the ones compiled into ProductionEvaluator,
+        // which the search then evaluates with instead (see agents/static_weights.h)
+        // Checked on every search, as the weights can be changed at any time
+        static bool compiled(const QuantizedWeights &q)
+        {
+            return q == ProductionEvaluator::Q;
+        }
+
+        // Score of a pawn's material at the stage. Scores are in the units of
+        // the weights, so this is what a centipawn is a hundredth of (see
+        // Uci::report). Stages which don't weigh material fall back to later ones
+        Score pawn_score(Game::GameStage stage) const
+        {
+            return pawn_score(quantized(), stage);
+        }
+        static Score pawn_score(const QuantizedWeights &q, Game::GameStage stage)
+        {
+            for (auto s : {stage, Game::GameStage::MidGame, Game::GameStage::Endgame})
+            {
+                int64_t pawn = ((int64_t)q.values.pawn * q.stages[s].material) >> SUM_SHIFT;
+                if (pawn > 0)
+                    return (Score)pawn;
+            }
+            return 100;
+        }
+
+        // The production agent (production.agent)
+        static Weighted production()
+        {
+            return Weighted::decode(production::SOURCE);
+        }
+
         static Weighted from_file(std::string path)
         {
             std::ifstream file(path);
@@ -49,6 +106,13 @@ namespace chess::agents
         }
 
         float weightedsum(const Game &game, Game::Team team) const
+        {
+            return weightedsum(game, team, PawnStructure::evaluate(game));
+        }
+
+        // The pawn terms are passed in, so that the search
+        // can fetch them from the pawn hash table
+        float weightedsum(const Game &game, Game::Team team, const PawnStructure &pawns) const
         {
             if (game.state == Game::State::WhiteWins && team == Game::Team::White)
                 return INF;
@@ -60,6 +124,29 @@ namespace chess::agents
                 return -INF;
             else if (game.state == Game::State::Stalemate)
                 return 0;
+            return weightedsum(evaluators::EvalContext(game), team, pawns);
+        }
+
+        // Sums of both teams (indexed by Game::Team), sharing one EvalContext
+        std::array<float, 2> weightedsums(const Game &game, const PawnStructure &pawns) const
+        {
+            std::array<float, 2> sums;
+            if (game.state != Game::State::WhiteToMove && game.state != Game::State::BlackToMove)
+            {
+                for (auto team : {Game::Team::White, Game::Team::Black})
+                    sums[(int)team] = weightedsum(game, team, pawns);
+                return sums;
+            }
+            evaluators::EvalContext ctx(game);
+            for (auto team : {Game::Team::White, Game::Team::Black})
+                sums[(int)team] = weightedsum(ctx, team, pawns);
+            return sums;
+        }
+
+        // NOTE: Only for positions with a team to move, see EvalContext
+        float weightedsum(const evaluators::EvalContext &ctx, Game::Team team, const PawnStructure &pawns) const
+        {
+            const Game &game = ctx.game;
 //    // Macro to chose weight depending on game stage
 #define weight(name)                                                 \
     (game.stage == Game::GameStage::Opening   ? weights.name.opening \
@@ -76,16 +163,21 @@ namespace chess::agents
             float w_kingfrontpawns = weight(king_front_pawns);
             float w_centercontrol = weight(center_control);
             float w_covered = weight(protected_pieces);
+            float w_passed = weight(passed_pawns);
+            float w_isolated = weight(isolated_pawns);
+            float w_doubled = weight(doubled_pawns);
+            auto &pawn_terms = pawns.of(team);
             // Apply the weights to fetched values
-            float check = evaluators::check(game, team) * w_check;
+            float check = evaluators::check(ctx, team) * w_check;
             float mobility = evaluators::mobility(game, team) * w_mobility;
-            float vulnerability = evaluators::vulnerability(game, team, weights.values) * w_vulnerability;
-            float pawn_devel = evaluators::pawn_development(game, team) * w_pawn_devel;
+            float vulnerability = evaluators::vulnerability(ctx, team, weights.values) * w_vulnerability;
+            float pawn_devel = pawn_terms.development * w_pawn_devel;
             float positioning = evaluators::positioning(game, team, weights.positions) * w_positioning;
             float material = evaluators::material_advantage(game, team, weights.values) * w_materialadv;
-            float king_front_pawns = evaluators::king_front_pawns(game, team) * w_kingfrontpawns;
-            float center_control = evaluators::center_control(game, team) * w_centercontrol;
-            float covered = evaluators::covered_pieces(game, team, weights.values) * w_covered;
+            float king_front_pawns = pawn_terms.king_front * w_kingfrontpawns;
+            float center_control = evaluators::center_control(ctx, team) * w_centercontrol;
+            float covered = evaluators::covered_pieces(ctx, team, weights.values) * w_covered;
+            float pawn_structure = pawn_terms.passed * w_passed - pawn_terms.isolated * w_isolated - pawn_terms.doubled * w_doubled;
 
             float misc_contributors = 0;
 
@@ -95,88 +187,559 @@ namespace chess::agents
                 //        misc_contributors -= weights.queen_early_movement;
             }
 
-            return check + mobility + vulnerability + pawn_devel + positioning + material + king_front_pawns + center_control + covered + misc_contributors;
+            return check + mobility + vulnerability + pawn_devel + positioning + material + king_front_pawns + center_control + covered + pawn_structure + misc_contributors;
+        }
+
+        struct SearchResult
+        {
+            Game::Move bestmove;
+            Score score = -scores::INFINITE;
+            int depth = 0;
+            uint64_t nodes = 0;
+            PruningStats pruned;
+            // Principal variation, see Game::Move::packed()
+            std::vector<uint16_t> pv;
+
+            // Totals over every thread
+            SearchStats stats;
+            std::vector<IterationStats> iterations;
+            int64_t time_ms = 0;
+
+            // Ratio between the node counts of the last two iterations
+            double branching_factor() const
+            {
+                return iterations.empty() ? 0 : iterations.back().branching_factor;
+            }
+
+            // A single line of JSON, for the logs
+            std::string stats_json() const
+            {
+                std::ostringstream out;
+                out << "{\"move\":\"" << (pv.empty() ? "0000" : Game::Move::packed_str(pv[0]))
+                    << "\",\"depth\":" << depth << ",\"score\":" << score
+                    << ",\"time_ms\":" << time_ms << ",\"branching_factor\":" << branching_factor()
+                    << "," << stats.json() << ",\"iterations\":[";
+                for (size_t i = 0; i < iterations.size(); i++)
+                    out << (i ? "," : "") << iterations[i].json();
+                out << "]}";
+                return out.str();
+            }
+        };
+
+        //
+        // Shared between the caller and a running search, so that it can be
+        // stopped or have its depth changed from another thread
+        //
+        struct SearchControl
+        {
+            std::atomic<bool> stop = false;
+            // Deepest iteration the main thread will run
+            std::atomic<int> max_depth = 0;
+            // Deepest iteration the main thread has completed
+            std::atomic<int> completed_depth = 0;
+
+            // Nodes searched by every thread so far, updated in batches
+            std::atomic<uint64_t> nodes = 0;
+            // Stop once this many nodes were searched (0 for no limit)
+            std::atomic<uint64_t> max_nodes = 0;
+            // Stop at this steady_clock time, in milliseconds (0 for no limit)
+            std::atomic<int64_t> deadline = 0;
+
+            // Called by the main thread after every completed iteration
+            std::function<void(const SearchResult &)> on_iteration;
+
+            static int64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+            }
+            void set_time_limit(int64_t milliseconds) { deadline = now() + milliseconds; }
+
+            bool out_of_budget() const
+            {
+                auto n = max_nodes.load(std::memory_order_relaxed);
+                auto d = deadline.load(std::memory_order_relaxed);
+                return (n && nodes.load(std::memory_order_relaxed) >= n) || (d && now() >= d);
+            }
+        };
+
+        //
+        // Per-thread search state
+        // every thread (main and helpers) owns one of these, everything else
+        // besides the transposition table is private to the thread
+        //
+        struct SearchWorker
+        {
+            static constexpr int MAX_PLY = MoveOrdering::MAX_PLY;
+
+            int id = 0;
+            int ply = 0;
+            SearchStats stats;
+            PruningStats pruned;
+            MoveOrdering ordering;
+            SearchControl *control = nullptr;
+
+            //
+            // Triangular PV table
+            // https://www.chessprogramming.org/Triangular_PV-Table
+            // pv[ply] holds the best line found from ply onwards
+            //
+            std::array<std::array<uint16_t, MAX_PLY>, MAX_PLY> pv{};
+            std::array<int, MAX_PLY> pv_length{};
+
+            // The previous iteration's PV, searched first by the next one
+            std::vector<uint16_t> prev_pv;
+            bool follow_pv = false;
+
+            // Mixed into the eval cache keys, so that agents with different
+            // weights never read each other's evaluations (see eval_key)
+            uint64_t eval_salt = 0;
+            QuantizedWeights weights;
+            // The weights are the production ones (see Weighted::compiled)
+            bool compiled = false;
+            // Indexed by Game::GameStage (see leaf_eval)
+            std::array<Score, 3> lazy_margin{};
+            // The pruning margins and aspiration windows in score
+            // units, indexed by Game::GameStage (see pawn_score)
+            std::array<PruningSettings::Margins, 3> frontier_margins{};
+            std::array<Score, 3> pawn{};
+
+            bool aborted() const { return control && control->stop.load(std::memory_order_relaxed); }
+
+            // Limits are only polled every so often, the clock isn't free
+            static constexpr uint64_t POLL_INTERVAL = 1024;
+            uint64_t reported_nodes = 0;
+
+            void count_node()
+            {
+                stats.seldepth = std::max(stats.seldepth, ply);
+                if (++stats.nodes % POLL_INTERVAL == 0)
+                    poll();
+            }
+            void poll()
+            {
+                if (!control)
+                    return;
+                control->nodes += stats.nodes - reported_nodes;
+                reported_nodes = stats.nodes;
+                if (id == 0 && control->out_of_budget())
+                    control->stop = true;
+            }
+
+            void update_pv(uint16_t move)
+            {
+                if (ply >= MAX_PLY - 1)
+                    return;
+                pv[ply][0] = move;
+                int child_length = pv_length[ply + 1];
+                for (int i = 0; i < child_length; i++)
+                    pv[ply][i + 1] = pv[ply + 1][i];
+                pv_length[ply] = child_length + 1;
+            }
+        };
+
+
+        // Move the move matching `packed` to the front of the list
+        static void hoist_move(std::vector<Game::Move> &moves, uint16_t packed)
+        {
+            if (!packed)
+                return;
+            for (size_t i = 0; i < moves.size(); i++)
+            {
+                if (moves[i].packed() == packed)
+                {
+                    std::rotate(moves.begin(), moves.begin() + i, moves.begin() + i + 1);
+                    return;
+                }
+            }
+        }
+
+        //
+        // Static evaluation of a leaf, relative to the team to move
+        //
+        // Lazy evaluation
+        // https://www.chessprogramming.org/Lazy_Evaluation
+        //
+        // Given the window the caller decides with, the attack terms are only
+        // computed when the cheap terms leave the score within the stage's
+        // lazy_margin of it. Otherwise the cheap score is returned, on the bet
+        // that the full one would lie on the same side of the window. It is a
+        // heuristic: the margin is what the attack terms typically add, not
+        // the most they can (see agents::lazy_margin), so a leaf they would
+        // have swung further is misjudged. Such scores are never cached, they
+        // are only good for their window
+        //
+        Score leaf_eval(const Game &game, SearchWorker &worker, Score alpha = -scores::INFINITE,
+                        Score beta = scores::INFINITE) const
+        {
+            // Mate always leaves the mated team to move
+            if (game.state == Game::State::Stalemate)
+                return 0;
+            if (game.state == Game::State::WhiteWins || game.state == Game::State::BlackWins)
+                return scores::mated_in(worker.ply);
+
+            Score sign = game.current_active_team() == Game::Team::White ? 1 : -1;
+            uint64_t key = eval_key(game, worker);
+            EvalCache::Entry entry;
+            if (eval_cache_size)
+            {
+                worker.stats.eval_probes++;
+                if (eval_table().probe(key, entry))
+                {
+                    worker.stats.eval_hits++;
+                    return sign * entry.white;
+                }
+            }
+
+            auto pawns = pawn_structure(game, worker);
+            if (lazy_eval && (alpha > -scores::INFINITE || beta < scores::INFINITE))
+            {
+                worker.stats.lazy_probes++;
+                Score cheap = sign * cheap_score(game, pawns, worker);
+                int64_t margin = worker.lazy_margin[game.stage];
+                if (cheap + margin <= alpha || cheap - margin >= beta)
+                {
+                    worker.stats.lazy_exits++;
+                    return cheap;
+                }
+            }
+
+            entry.white = leaf_score(game, pawns, worker);
+            if (eval_cache_size)
+                eval_table().store(key, entry);
+            return sign * entry.white;
+        }
+
+        // The score the search evaluates with, for white
+        Score leaf_score(const Game &game, const PawnStructure &pawns, const SearchWorker &worker) const
+        {
+            if (worker.compiled)
+                return ProductionEvaluator::score(game, pawns);
+            evaluators::EvalContext ctx(game);
+            return fixed_score(ctx, pawns, worker.weights, worker.weights.stages[game.stage]);
+        }
+
+        // Its terms which don't need the attack maps, for white
+        Score cheap_score(const Game &game, const PawnStructure &pawns, const SearchWorker &worker) const
+        {
+            if (worker.compiled)
+                return ProductionEvaluator::cheap(game, pawns);
+            return agents::cheap_score(game, pawns, worker.weights, worker.weights.stages[game.stage]);
+        }
+
+        // Pawn terms of the evaluation, through the pawn hash table
+        PawnStructure pawn_structure(const Game &game, SearchWorker &worker) const
+        {
+            if (!pawn_hash_size)
+                return PawnStructure::evaluate(game);
+
+            auto &table = pawn_table();
+            PawnStructure pawns;
+            worker.stats.pawn_probes++;
+            if (table.probe(game.pawn_hash, pawns))
+            {
+                worker.stats.pawn_hits++;
+                return pawns;
+            }
+            pawns = PawnStructure::evaluate(game);
+            table.store(game.pawn_hash, pawns);
+            return pawns;
+        }
+
+        // The weighted sums also depend on the stage of the game, which
+        // the zobrist hash does not cover
+        static uint64_t eval_key(const Game &game, const SearchWorker &worker)
+        {
+            return game.zobrist_hash ^ worker.eval_salt ^ ((uint64_t)game.stage * 0x9E3779B97F4A7C15ULL);
+        }
+
+        //
+        // Delta pruning
+        // https://www.chessprogramming.org/Delta_Pruning
+        //
+        // Winning material of value V raises our material term by V and lowers
+        // theirs by V. The victim also leaves their piece count (mobility) and
+        // their covered pieces, so the best a capture can do is the sum of those
+        //
+        bool delta_prunable(const Game &game, const Game::Move &move, Score stand_pat, Score alpha, const SearchWorker &worker) const
+        {
+            auto &w = worker.weights.stages[game.stage];
+            int64_t victim = quantize(MoveOrdering::gain(game, move, weights.values) + delta_margin * weights.values.pawn, PIECE_SHIFT);
+            int64_t d = victim * (2 * (int64_t)w.material + w.protected_pieces) + (int64_t)w.mobility * (1 << PIECE_SHIFT);
+            return stand_pat + d / (1LL << SUM_SHIFT) <= alpha;
+        }
+
+        //
+        // Quiescence search
+        // https://www.chessprogramming.org/Quiescence_Search
+        //
+        // Keep searching captures (and queen promotions) past the horizon
+        // until the position is quiet, so that hanging pieces are accounted for
+        //
+        Score quiesce(Game &game, Score alpha, Score beta, SearchWorker &worker) const
+        {
+            worker.count_node();
+            worker.stats.qnodes++;
+            if (worker.ply < SearchWorker::MAX_PLY)
+                worker.pv_length[worker.ply] = 0;
+            if (worker.aborted())
+                return 0;
+
+            if (game.state != Game::State::BlackToMove && game.state != Game::State::WhiteToMove)
+                return leaf_eval(game, worker);
+
+            auto team = game.current_active_team();
+            Score stand_pat = leaf_eval(game, worker, alpha, beta);
+            Score besteval = -scores::INFINITE;
+
+            // Standing pat is not an option while in check,
+            // every evasion has to be searched instead
+            bool in_check = team == Game::Team::White ? game.is_checked<Game::Team::White>() : game.is_checked<Game::Team::Black>();
+            if (!in_check)
+            {
+                if (stand_pat >= beta)
+                    return stand_pat;
+                besteval = stand_pat;
+                alpha = std::max(alpha, stand_pat);
+            }
+
+            auto moves = game.movelist(team, !in_check);
+            MoveOrdering::order_tactical(game, moves, weights.values);
+            for (auto move : moves)
+            {
+                if (!in_check && delta_prunable(game, move, stand_pat, alpha, worker))
+                {
+                    worker.pruned.delta_pruned++;
+                    continue;
+                }
+                if (!in_check && pruning.see_pruning && MoveOrdering::is_losing(game, move, weights.values))
+                {
+                    worker.pruned.see_pruned++;
+                    continue;
+                }
+
+                auto newgame = game;
+                newgame.make_move(move);
+                worker.ply++;
+                auto eval = -quiesce(newgame, -beta, -alpha, worker);
+                worker.ply--;
+                besteval = std::max(besteval, eval);
+                alpha = std::max(alpha, eval);
+                if (alpha >= beta)
+                    break;
+            }
+            return besteval;
         }
 
-        float minimax(Game &game, Game::Team ourteam, int depth, float alpha, float beta, bool maximizingplayer) const
+        //
+        // Principal Variation Search
+        // https://www.chessprogramming.org/Principal_Variation_Search
+        //
+        // Scores are relative to the team to move. The first move is searched
+        // with the full window, every later one only has to prove that it is no
+        // better than it, which a zero-width window does much cheaper
+        //
+        Score negamax(Game &game, int depth, Score alpha, Score beta, SearchWorker &worker, bool allow_null = true) const
         {
-            //    std::cout << game.zobrist_hash << std::endl;
-            auto enemy =
-                ourteam == Game::Team::White ? Game::Team::Black : Game::Team::White;
+            worker.count_node();
+            if (worker.ply < SearchWorker::MAX_PLY)
+                worker.pv_length[worker.ply] = 0;
+            if (worker.aborted())
+                return 0;
+
+            if (game.state != Game::State::BlackToMove && game.state != Game::State::WhiteToMove)
+                return leaf_eval(game, worker);
+            if (depth == 0 || worker.ply >= SearchWorker::MAX_PLY - 1)
+                return quiescence ? quiesce(game, alpha, beta, worker) : leaf_eval(game, worker, alpha, beta);
+
+            bool pv_node = beta > alpha + 1;
 
             //
             // Do a transposition table lookup
             //
-            //    if(Game::transposition_table.contains(game.zobrist_hash)){
-            //        auto& table_entry = Game::transposition_table[game.zobrist_hash];
-            //        // The entry must be at the same depth, or deeper
-            //        // this ensures we dont take less accurate evaluations
-            //        // from previous iterations
-            //        if(table_entry.depth >= depth){
-            //            if(table_entry.type == Game::TranspositionTableEntry::Exact){
-            //                return table_entry.evaluation;
-            //            }
-            //            else if(table_entry.type == Game::TranspositionTableEntry::Lowerbound){
-            //                alpha = std::max(alpha, table_entry.evaluation);
-            //            }
-            //            else if(table_entry.type == Game::TranspositionTableEntry::Upperbound){
-            //                beta = std::min(beta, table_entry.evaluation);
-            //            }
-            //            if(alpha > beta){
-            //                return table_entry.evaluation;
-            //            }
-            //        }
-            //    }
-
-            if (depth == 0 || (game.state != Game::State::BlackToMove &&
-                               game.state != Game::State::WhiteToMove))
+            auto &tt = table();
+            auto key = game.zobrist_hash;
+            TranspositionTable::Entry entry;
+            uint16_t tt_move = 0;
+            worker.stats.tt_probes++;
+            if (tt.probe(key, entry))
             {
-                auto eval = weightedsum(game, ourteam) / weightedsum(game, enemy);
-                //        Game::transposition_table[game.zobrist_hash].depth = depth;
-                //        Game::transposition_table[game.zobrist_hash].evaluation = eval;
-                //        Game::transposition_table[game.zobrist_hash].type = Game::TranspositionTableEntry::Exact;
+                worker.stats.tt_hits++;
+                entry.evaluation = scores::from_table(entry.evaluation, worker.ply);
+                tt_move = entry.move;
+                // The entry must be at the same depth, or deeper
+                // this ensures we dont take less accurate evaluations
+                // from previous iterations
+                // PV nodes never cut, that would truncate the PV
+                if (entry.depth >= depth && !pv_node &&
+                    (entry.type == TranspositionTable::Exact ||
+                     (entry.type == TranspositionTable::Lowerbound && entry.evaluation >= beta) ||
+                     (entry.type == TranspositionTable::Upperbound && entry.evaluation <= alpha)))
+                {
+                    worker.stats.tt_cutoffs++;
+                    return entry.evaluation;
+                }
+            }
+            const Score alpha_orig = alpha;
+
+            auto team = game.current_active_team();
+            bool in_check = team == Game::Team::White ? game.is_checked<Game::Team::White>() : game.is_checked<Game::Team::Black>();
 
-                return eval;
+            //
+            // Null move pruning
+            // Skipped in check (passing would be illegal), and in the endgame where
+            // zugzwang makes passing better than any real move
+            //
+            if (pruning.null_move && allow_null && !pv_node && !in_check && beta < scores::MATE_BOUND &&
+                depth >= pruning.null_move_min_depth && game.stage != Game::GameStage::Endgame)
+            {
+                worker.pruned.null_move_tries++;
+                int reduced = std::max(depth - 1 - pruning.null_reduction(depth), 0);
+                auto nullgame = game;
+                nullgame.make_null_move();
+                worker.ply++;
+                worker.follow_pv = false;
+                auto eval = -negamax(nullgame, reduced, -beta, -beta + 1, worker, false);
+                worker.ply--;
+
+                if (eval >= beta && depth >= pruning.null_move_verify_depth)
+                {
+                    // Verify with a reduced search of our real moves
+                    int verify = std::max(depth - pruning.null_reduction(depth), 1);
+                    eval = negamax(game, verify, beta - 1, beta, worker, false);
+                }
+                if (eval >= beta && !worker.aborted())
+                {
+                    worker.pruned.null_move_cutoffs++;
+                    return eval;
+                }
             }
 
-            if (maximizingplayer)
+            //
+            // Frontier nodes, decided by the static evaluation
+            //
+            bool futile = false;
+            bool frontier = !pv_node && !in_check && alpha > -scores::MATE_BOUND &&
+                            ((pruning.futility && depth <= pruning.futility_max_depth) ||
+                             (pruning.razoring && depth <= pruning.razoring_max_depth));
+            if (frontier)
             {
-                float maxeval = -INF;
-                for (auto move : game.movelist(ourteam))
+                bool futility = pruning.futility && depth <= pruning.futility_max_depth;
+                auto &margins = worker.frontier_margins[game.stage];
+                // Only which side of alpha - margin the evaluation lies on matters
+                Score threshold = alpha - (futility ? margins.futility_at(depth) : margins.razor_at(depth));
+                Score static_eval = leaf_eval(game, worker, threshold, threshold + 1);
+                if (futility)
+                {
+                    futile = static_eval + margins.futility_at(depth) <= alpha;
+                }
+                else if (pruning.razoring && static_eval + margins.razor_at(depth) <= alpha)
                 {
-                    auto newgame = game;
-                    newgame.make_move(move);
-                    auto eval = minimax(newgame, ourteam, depth - 1, alpha, beta, false);
-                    maxeval = std::max(maxeval, eval);
-                    alpha = std::max(alpha, eval);
-                    if (beta <= alpha)
+                    // Drop the node if captures alone can't get back above the margin
+                    worker.pruned.razor_tries++;
+                    Score target = alpha - margins.razor_at(depth);
+                    auto eval = quiesce(game, target, target + 1, worker);
+                    if (eval <= target && !worker.aborted())
                     {
-                        break;
+                        worker.pruned.razor_cutoffs++;
+                        return eval;
                     }
                 }
-                //        Game::transposition_table[game.zobrist_hash].depth = depth;
-                //        Game::transposition_table[game.zobrist_hash].evaluation = maxeval;
-                return maxeval;
             }
-            else
+
+            // While on the previous iteration's PV, its move comes first
+            bool on_pv = worker.follow_pv && worker.ply < (int)worker.prev_pv.size();
+            uint16_t pv_move = on_pv ? worker.prev_pv[worker.ply] : 0;
+
+            auto moves = game.movelist(team);
+            worker.ordering.order(game, moves, worker.ply, pv_move ? pv_move : tt_move, weights.values);
+
+            Score besteval = -scores::INFINITE;
+            uint16_t bestmove = moves.size() ? moves[0].packed() : 0;
+            int move_number = 0;
+            for (auto move : moves)
             {
-                float mineval = INF;
-                for (auto move : game.movelist(enemy))
+                move_number++;
+                auto newgame = game;
+                newgame.make_move(move);
+
+                // Futile quiet moves are skipped, unless they give check
+                if (futile && move_number > 1 && MoveOrdering::is_quiet(move) &&
+                    newgame.state != Game::State::WhiteWins && newgame.state != Game::State::BlackWins &&
+                    !(team == Game::Team::White ? newgame.is_checked<Game::Team::Black>() : newgame.is_checked<Game::Team::White>()))
                 {
-                    auto newgame = game;
-                    newgame.make_move(move);
-                    auto eval = minimax(newgame, ourteam, depth - 1, alpha, beta, true);
-                    mineval = std::min(mineval, eval);
-                    beta = std::min(beta, eval);
-                    if (beta <= alpha)
+                    worker.pruned.futility_pruned++;
+                    continue;
+                }
+
+                worker.ply++;
+                worker.follow_pv = on_pv && move.packed() == pv_move;
+
+                Score eval;
+                if (move_number == 1)
+                    eval = -negamax(newgame, depth - 1, -beta, -alpha, worker);
+                else
+                {
+                    //
+                    // Late move reductions
+                    // Quiet moves ordered late get their zero window search at a
+                    // reduced depth, and only get the full depth if they beat alpha
+                    //
+                    int reduction = 0;
+                    if (pruning.late_move_reductions && !in_check && depth >= pruning.lmr_min_depth &&
+                        move_number > pruning.lmr_full_depth_moves && MoveOrdering::is_quiet(move))
                     {
-                        break;
+                        reduction = std::min(pruning.late_move_reduction(depth, move_number), depth - 1);
                     }
+
+                    if (reduction)
+                        worker.pruned.lmr_reductions++;
+
+                    eval = -negamax(newgame, depth - 1 - reduction, -alpha - 1, -alpha, worker);
+                    if (eval > alpha && reduction)
+                    {
+                        worker.pruned.lmr_researches++;
+                        eval = -negamax(newgame, depth - 1, -alpha - 1, -alpha, worker);
+                    }
+                    if (eval > alpha && eval < beta)
+                        eval = -negamax(newgame, depth - 1, -beta, -alpha, worker);
+                }
+                worker.ply--;
+
+                if (eval > besteval)
+                {
+                    besteval = eval;
+                    bestmove = move.packed();
+                }
+                if (eval > alpha)
+                {
+                    alpha = eval;
+                    worker.update_pv(move.packed());
+                }
+                if (alpha >= beta)
+                {
+                    worker.stats.beta_cutoffs++;
+                    if (move_number == 1)
+                        worker.stats.first_move_cutoffs++;
+                    worker.ordering.on_cutoff(move, worker.ply, depth);
+                    break;
                 }
-                //        Game::transposition_table[game.zobrist_hash].depth = depth;
-                //        Game::transposition_table[game.zobrist_hash].evaluation = mineval;
-                return mineval;
             }
+
+            // Results of an aborted search are garbage, never store them
+            if (worker.aborted())
+                return besteval;
+
+            TranspositionTable::Entry store;
+            store.evaluation = scores::to_table(besteval, worker.ply);
+            store.depth = depth;
+            store.move = bestmove;
+            store.type = besteval <= alpha_orig ? TranspositionTable::Upperbound
+                         : besteval >= beta     ? TranspositionTable::Lowerbound
+                                                : TranspositionTable::Exact;
+            tt.store(key, store);
+            return besteval;
         }
 
         [[nodiscard]] std::map<std::string, const evaluators::EvalParameter *> PARAMETERS() const
@@ -193,6 +756,9 @@ namespace chess::agents
             ret["king_front_pawns"] = &weights.king_front_pawns;
             ret["center_control"] = &weights.center_control;
             ret["protected_pieces"] = &weights.protected_pieces;
+            ret["passed_pawns"] = &weights.passed_pawns;
+            ret["isolated_pawns"] = &weights.isolated_pawns;
+            ret["doubled_pawns"] = &weights.doubled_pawns;
             return ret;
         }
         //
@@ -248,33 +814,298 @@ namespace chess::agents
             return agent;
         }
 
-        int search_depth = 6;
+        // The quiescence search resolves captures past the horizon, which
+        // lets us get away with a shallower nominal depth
+        int search_depth = 4;
+        bool quiescence = true;
 
-        Game::Move move(const Game &g) const override
+        // Extra material (in pawns) a capture must be able to win on top
+        // of the victim, before the quiescence search gives up on it
+        float delta_margin = 2;
+
+        // Null move pruning, late move reductions, etc.
+        PruningSettings pruning;
+
+        // Skip the attack terms of leaves the cheap terms most likely decide, by
+        // margins taken from the weights on every search (see leaf_eval)
+        bool lazy_eval = true;
+
+        // Half-width of the first aspiration window in pawns, widened by doubling
+        // on every fail until it exceeds the max, after which the window is open
+        float aspiration_window = 0.25;
+        float aspiration_max_window = 8;
+        int aspiration_min_depth = 4;
+
+        // Number of threads used by the search (Lazy SMP)
+        // 1 keeps the search entirely on the calling thread
+        int threads = 1;
+
+        // Size of the transposition table in megabytes
+        size_t hash_size = 16;
+
+        // The table is created lazily (training builds thousands of agents
+        // which never search) and is shared between copies of the agent
+        TranspositionTable &table() const
         {
-            Game::Move bestmove;
-            float bestmovescore = -INF;
-            auto all_moves = g.movelist(g.current_active_team());
-
-            // Handle the case where all evaluations lead to mate
-            // Floating point comparison -inf > -inf will return false otherwise
-            // and the engine will crash
-            if (all_moves.size() > 0)
-                bestmove = all_moves[0];
-            for (auto move : all_moves)
+            if (!transpositions)
+                transpositions = std::make_shared<TranspositionTable>(hash_size);
+            return *transpositions;
+        }
+
+        // Size of the eval cache in megabytes, 0 disables it
+        size_t eval_cache_size = 4;
+
+        EvalCache &eval_table() const
+        {
+            if (!evaluations)
+                evaluations = std::make_shared<EvalCache>(eval_cache_size);
+            return *evaluations;
+        }
+
+        // Size of the pawn hash table in megabytes, 0 disables it
+        size_t pawn_hash_size = 1;
+
+        PawnTable &pawn_table() const
+        {
+            if (!pawn_structures)
+                pawn_structures = std::make_shared<PawnTable>(pawn_hash_size);
+            return *pawn_structures;
+        }
+
+        //
+        // Searches every root move to the given depth, within (alpha, beta)
+        // the best line ends up in worker.pv[0]
+        //
+        Score search_root_moves(Game &root, std::vector<Game::Move> &moves, int depth, Score alpha, Score beta,
+                                SearchWorker &worker, Game::Move &bestmove) const
+        {
+            Score bestscore = -scores::INFINITE;
+            worker.pv_length[0] = 0;
+            for (size_t i = 0; i < moves.size(); i++)
             {
-                auto newgame = g;
+                auto &move = moves[i];
+                auto newgame = root;
                 newgame.make_move(move);
-                auto score = minimax(newgame, g.current_active_team(), search_depth - 1, -INF,
-                                     INF, false);
-                if (score > bestmovescore)
+                worker.ply = 1;
+                worker.follow_pv = worker.prev_pv.size() && worker.prev_pv[0] == move.packed();
+
+                Score score;
+                if (i == 0)
+                    score = -negamax(newgame, depth - 1, -beta, -alpha, worker);
+                else
+                {
+                    score = -negamax(newgame, depth - 1, -alpha - 1, -alpha, worker);
+                    if (score > alpha && score < beta)
+                        score = -negamax(newgame, depth - 1, -beta, -alpha, worker);
+                }
+                worker.ply = 0;
+                if (worker.aborted())
+                    return bestscore;
+
+                if (score > bestscore)
                 {
+                    bestscore = score;
                     bestmove = move;
-                    bestmovescore = score;
                 }
+                if (score > alpha)
+                {
+                    alpha = score;
+                    worker.update_pv(move.packed());
+                }
+                if (alpha >= beta)
+                    break;
+            }
+            return bestscore;
+        }
+
+        //
+        // Iterative deepening over the root moves, up to the control's max_depth
+        // returns the best move of the deepest fully searched iteration
+        //
+        SearchResult search_root(Game &root, SearchWorker &worker) const
+        {
+            SearchResult result;
+            auto team = root.current_active_team();
+            auto all_moves = root.movelist(team);
+
+            if (all_moves.size() == 0)
+                return result;
+            worker.ordering.order(root, all_moves, 0, 0, weights.values);
+            result.bestmove = all_moves[0];
+
+            // Helpers search the root moves in a different order so that
+            // they don't all walk the same tree in lockstep
+            if (worker.id)
+                std::rotate(all_moves.begin(), all_moves.begin() + worker.id % all_moves.size(), all_moves.end());
+
+            // Odd helpers skip every other depth, and run one ply deeper
+            // than the main thread, so they keep filling the table ahead of it
+            int step = worker.id % 2 ? 2 : 1;
+            auto max_depth = [&]()
+            { return worker.control->max_depth.load() + (worker.id % 2); };
+
+            for (int depth = step; depth <= max_depth(); depth += step)
+            {
+                auto iteration_start = SearchControl::now();
+                auto stats_before = worker.stats;
+                //
+                // Aspiration windows
+                // https://www.chessprogramming.org/Aspiration_Windows
+                // Search a narrow window around the last score first, and widen
+                // the side that failed until the score lands inside it
+                //
+                Score pawn = worker.pawn[root.stage];
+                Score delta = std::max(scores::from_pawns(aspiration_window, pawn), 1);
+                Score max_window = scores::from_pawns(aspiration_max_window, pawn);
+                bool aspirate = depth >= aspiration_min_depth && result.depth && !scores::is_mate(result.score);
+                Score alpha = aspirate ? result.score - delta : -scores::INFINITE;
+                Score beta = aspirate ? result.score + delta : scores::INFINITE;
+
+                Game::Move bestmove = all_moves[0];
+                Score score;
+                while (true)
+                {
+                    score = search_root_moves(root, all_moves, depth, alpha, beta, worker, bestmove);
+                    if (worker.aborted())
+                        return result;
+
+                    delta *= 2;
+                    if (score <= alpha && alpha > -scores::INFINITE)
+                        alpha = delta > max_window ? -scores::INFINITE : result.score - delta;
+                    else if (score >= beta && beta < scores::INFINITE)
+                        beta = delta > max_window ? scores::INFINITE : result.score + delta;
+                    else
+                        break;
+                }
+
+                result.bestmove = bestmove;
+                result.score = score;
+                result.depth = depth;
+                worker.prev_pv.assign(worker.pv[0].begin(), worker.pv[0].begin() + worker.pv_length[0]);
+                result.pv = worker.prev_pv;
+                if (worker.id == 0)
+                {
+                    IterationStats iteration;
+                    iteration.depth = depth;
+                    iteration.time_ms = SearchControl::now() - iteration_start;
+                    iteration.stats = worker.stats.since(stats_before);
+                    if (!result.iterations.empty() && result.iterations.back().stats.nodes)
+                        iteration.branching_factor = (double)iteration.stats.nodes / result.iterations.back().stats.nodes;
+                    result.iterations.push_back(iteration);
+
+                    worker.poll();
+                    worker.control->completed_depth = depth;
+                    if (worker.control->on_iteration)
+                    {
+                        result.nodes = worker.control->nodes;
+                        worker.control->on_iteration(result);
+                    }
+                }
+
+                // Search the previous iteration's best move first
+                hoist_move(all_moves, bestmove.packed());
             }
-            //    std::cout << "=== Chose Move: " << bestmove.str() << std::endl;
-            return bestmove;
+            return result;
         }
+
+        //
+        // Lazy SMP
+        // https://www.chessprogramming.org/Lazy_SMP
+        //
+        // Every helper thread searches the same root on a copy of the game,
+        // the only thing they share is the transposition table. The main thread
+        // reports the result and stops the helpers once it is done
+        //
+        SearchResult search(const Game &g) const
+        {
+            SearchControl control;
+            control.max_depth = search_depth;
+            return search(g, control);
+        }
+
+        SearchResult search(const Game &g, SearchControl &control) const
+        {
+            // Created before the helper threads start, they would race to create them
+            (void)table();
+            if (eval_cache_size)
+                (void)eval_table();
+            if (pawn_hash_size)
+                (void)pawn_table();
+            auto started = SearchControl::now();
+            control.completed_depth = 0;
+            control.nodes = 0;
+            std::vector<SearchWorker> workers(std::max(threads, 1));
+            auto salt = std::hash<std::string>{}(encode());
+            auto evaluator_weights = quantized();
+            bool compiled_weights = compiled(evaluator_weights);
+            std::array<Score, 3> margins, pawns;
+            std::array<PruningSettings::Margins, 3> frontier;
+            for (size_t s = 0; s < margins.size(); s++)
+            {
+                margins[s] = agents::lazy_margin(evaluator_weights, evaluator_weights.stages[s]);
+                pawns[s] = std::max(pawn_score(evaluator_weights, (Game::GameStage)s), 1);
+                frontier[s] = pruning.margins(pawns[s]);
+            }
+            for (size_t i = 0; i < workers.size(); i++)
+            {
+                workers[i].id = i;
+                workers[i].control = &control;
+                workers[i].eval_salt = salt;
+                workers[i].weights = evaluator_weights;
+                workers[i].compiled = compiled_weights;
+                workers[i].lazy_margin = margins;
+                workers[i].frontier_margins = frontier;
+                workers[i].pawn = pawns;
+            }
+
+            // Copy the game before spawning anything, move generation
+            // writes into the piece cache of the game
+            std::vector<Game> roots(workers.size() - 1, g);
+            std::vector<std::thread> helpers;
+            for (size_t i = 1; i < workers.size(); i++)
+            {
+                helpers.emplace_back([this, &roots, &workers, i]()
+                                     { search_root(roots[i - 1], workers[i]); });
+            }
+
+            // The main thread searches the caller's game, so that the pieces
+            // referenced by the returned move outlive the search
+            auto result = search_root(const_cast<Game &>(g), workers[0]);
+
+            control.stop = true;
+            for (auto &h : helpers)
+                h.join();
+            result.nodes = 0;
+            for (auto &w : workers)
+            {
+                result.stats += w.stats;
+                result.nodes += w.stats.nodes;
+                result.pruned += w.pruned;
+            }
+            result.time_ms = SearchControl::now() - started;
+            last_search = result;
+            return result;
+        }
+
+        Game::Move move(const Game &g) const override
+        {
+            auto result = search(g);
+            if (log_stats)
+                std::clog << result.stats_json() << std::endl;
+            //    std::cout << "=== Chose Move: " << result.bestmove.str() << std::endl;
+            return result.bestmove;
+        }
+
+        // Print the statistics of every move() as a line of JSON to stderr
+        bool log_stats = false;
+
+        // Result of the most recent search, for callers that only
+        // go through move() (the C api)
+        mutable SearchResult last_search;
+
+    private:
+        mutable std::shared_ptr<TranspositionTable> transpositions;
+        mutable std::shared_ptr<EvalCache> evaluations;
+        mutable std::shared_ptr<PawnTable> pawn_structures;
     };
 };
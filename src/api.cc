@@ -1,7 +1,12 @@
 #include "./api.h"
 #include "./game.h"
 #include"./agents/weighted.h"
+#include"./ponder.h"
 #include "./agents/random.h"
+#include "./agents/nnue.h"
+#include "./perft.h"
+#include "./see.h"
+#include "./dataset.h"
 #include "bitboard.h"
 #include <iostream>
 #define asstate(p) ((chess::Game *)p)
@@ -24,6 +29,10 @@ uint8_t chess__move_to(void *move) {
 enum MoveKind chess__move_kind(void *move) {
   return (MoveKind)asmove(move)->kind;
 }
+float chess__move_see(void *game, void *move, const float *values) {
+  chess::evaluators::PerPiece pieces(values[0], values[1], values[2], values[3], values[4], values[5]);
+  return chess::see::evaluate(*asstate(game), *asmove(move), pieces);
+}
 void *chess__game_create(const char *FEN_str) {
   try {
     auto game = new chess::Game(chess::Game::create(FEN_str));
@@ -137,6 +146,25 @@ float chess__game_advantage(void *game, enum ChessTeam team, void* evaluator) {
 uint32_t chess__game_halfmoves(void *game) { return asstate(game)->halfmoves; }
 uint32_t chess__game_fullmoves(void *game) { return asstate(game)->fullmoves; }
 
+uint64_t chess__game_perft(void *game, uint32_t depth) { return depth ? perft(*asstate(game), depth) : 1; }
+
+uint32_t chess__game_fen(void *game, char *buffer, uint32_t size) {
+  auto fen = asstate(game)->simple_fen();
+  if (size) {
+    auto n = std::min<size_t>(fen.size(), size - 1);
+    fen.copy(buffer, n);
+    buffer[n] = 0;
+  }
+  return fen.size();
+}
+
+uint64_t chess__game_hash(void *game) { return asstate(game)->zobrist_hash; }
+
+void *chess__game_repack(void *game) {
+  auto packed = chess::dataset::PackedPosition::pack(*asstate(game), chess::Result::Draw);
+  return new chess::Game(packed.unpack());
+}
+
 void* chess__game_agent_move(void* game, void* agent){
   auto g = asstate(game);
   auto a = (chess::Agent*)agent;
@@ -149,29 +177,150 @@ void chess__delete_move(void* move){
 }
 
 void* chess__create_weighted_agent(){
-  const char* AGENT_DATA = 
-  "center_control;M;586.260437,161.158813,1.582336\n"
-  "check;M;589.273804,847.496948,62.811127\n"
-  "king_front_pawns;M;177.766479,1855.725586,1212.849854\n"
-  "material;M;305.160645,0.264507,1663.406128\n"
-  "mobility;M;409.657318,19720.175781,7176.076660\n"
-  "pawn_devel;M;1381.781372,1.422119,793.646545\n"
-  "positioning;M;1723.009399,0.669816,10.812225\n"
-  "positions;P;2.565273,46.566368,3.345390,9.758125,2.367783,3.347683\n"
-  "protected_pieces;M;734.776001,176.327698,518.665527\n"
-  "values;P;27.044556,10002.280273,6036.456055,2083.186523,2017.714600,69.289246\n"
-  "vulnerability;M;522.239380,0.151626,0.636688";
-  auto ag = new chess::agents::Weighted(chess::agents::Weighted::decode(AGENT_DATA));
-  return ag;
+  // Weights are compiled in from production.agent
+  return new chess::agents::Weighted(chess::agents::Weighted::production());
 }
 void* chess__create_random_agent(){
   return new chess::agents::Random();
 }
 
+void* chess__create_nnue_agent(const char* path){
+  try {
+    return path ? new chess::agents::Nnue(path) : new chess::agents::Nnue();
+  } catch (chess::Error &) {
+    return nullptr;
+  }
+}
+
 void chess__delete_weighted_agent(void* agent){
   delete (chess::agents::Weighted*)agent;
 }
 
 void chess__delete_random_agent(void* agent){
   delete (chess::agents::Random*)agent;
-}
\ No newline at end of file
+}
+
+void chess__delete_nnue_agent(void* agent){
+  delete (chess::agents::Nnue*)agent;
+}
+
+void chess__weighted_agent_set_threads(void* agent, uint32_t threads){
+  ((chess::agents::Weighted*)agent)->threads = threads ? threads : 1;
+}
+
+void chess__weighted_agent_set_feature(void* agent, enum SearchFeature feature, bool enabled){
+  auto ag = (chess::agents::Weighted*)agent;
+  switch (feature) {
+  case SF_Quiescence:
+    ag->quiescence = enabled;
+    break;
+  case SF_NullMove:
+    ag->pruning.null_move = enabled;
+    break;
+  case SF_LateMoveReductions:
+    ag->pruning.late_move_reductions = enabled;
+    break;
+  case SF_Futility:
+    ag->pruning.futility = enabled;
+    break;
+  case SF_Razoring:
+    ag->pruning.razoring = enabled;
+    break;
+  case SF_SeePruning:
+    ag->pruning.see_pruning = enabled;
+    break;
+  }
+}
+
+uint32_t chess__weighted_agent_pv(void* agent, char* buffer, uint32_t size){
+  auto ag = (chess::agents::Weighted*)agent;
+  std::string pv;
+  for (auto m : ag->last_search.pv) {
+    if (!pv.empty())
+      pv += " ";
+    pv += chess::Game::Move::packed_str(m);
+  }
+  if (size) {
+    auto n = std::min<size_t>(pv.size(), size - 1);
+    pv.copy(buffer, n);
+    buffer[n] = 0;
+  }
+  return pv.size();
+}
+
+SearchStatistics chess__weighted_agent_stats(void* agent){
+  auto &result = ((chess::agents::Weighted*)agent)->last_search;
+  SearchStatistics stats;
+  stats.nodes = result.stats.nodes;
+  stats.qnodes = result.stats.qnodes;
+  stats.tt_probes = result.stats.tt_probes;
+  stats.tt_hits = result.stats.tt_hits;
+  stats.tt_cutoffs = result.stats.tt_cutoffs;
+  stats.beta_cutoffs = result.stats.beta_cutoffs;
+  stats.first_move_cutoffs = result.stats.first_move_cutoffs;
+  stats.time_ms = result.time_ms;
+  stats.depth = result.depth;
+  stats.seldepth = result.stats.seldepth;
+  stats.branching_factor = result.branching_factor();
+  stats.eval_probes = result.stats.eval_probes;
+  stats.eval_hits = result.stats.eval_hits;
+  stats.pawn_probes = result.stats.pawn_probes;
+  stats.pawn_hits = result.stats.pawn_hits;
+  stats.lazy_probes = result.stats.lazy_probes;
+  stats.lazy_exits = result.stats.lazy_exits;
+  return stats;
+}
+
+uint32_t chess__weighted_agent_stats_json(void* agent, char* buffer, uint32_t size){
+  auto json = ((chess::agents::Weighted*)agent)->last_search.stats_json();
+  if (size) {
+    auto n = std::min<size_t>(json.size(), size - 1);
+    json.copy(buffer, n);
+    buffer[n] = 0;
+  }
+  return json.size();
+}
+
+void chess__weighted_agent_log_stats(void* agent, bool enabled){
+  ((chess::agents::Weighted*)agent)->log_stats = enabled;
+}
+
+void chess__weighted_agent_set_eval_cache(void* agent, uint32_t megabytes){
+  auto ag = (chess::agents::Weighted*)agent;
+  ag->eval_cache_size = megabytes;
+  if (megabytes)
+    ag->eval_table().resize(megabytes);
+}
+
+void chess__weighted_agent_set_pawn_hash(void* agent, uint32_t megabytes){
+  auto ag = (chess::agents::Weighted*)agent;
+  ag->pawn_hash_size = megabytes;
+  if (megabytes)
+    ag->pawn_table().resize(megabytes);
+}
+
+void chess__weighted_agent_set_lazy_eval(void* agent, bool enabled){
+  ((chess::agents::Weighted*)agent)->lazy_eval = enabled;
+}
+
+void* chess__ponder_start(void* game, void* agent){
+  auto g = (chess::Game*)game;
+  auto ponderer = new chess::Ponderer(*(chess::agents::Weighted*)agent);
+  if (!ponderer->start(*g)) {
+    delete ponderer;
+    return NULL;
+  }
+  return ponderer;
+}
+
+void* chess__ponder_hit(void* ponder, void* game){
+  auto ponderer = (chess::Ponderer*)ponder;
+  auto result = ponderer->ponderhit(*(chess::Game*)game);
+  if (!result)
+    return NULL;
+  return new chess::Game::Move(result->bestmove);
+}
+
+void chess__ponder_stop(void* ponder){
+  delete (chess::Ponderer*)ponder;
+}
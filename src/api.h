@@ -35,6 +35,17 @@ enum MoveKind {
   KingsideCastle,
 };
 
+// Selective search techniques of the weighted agent which
+// can be toggled at runtime (see chess__weighted_agent_set_feature)
+enum SearchFeature {
+  SF_Quiescence,
+  SF_NullMove,
+  SF_LateMoveReductions,
+  SF_Futility,
+  SF_Razoring,
+  SF_SeePruning,
+};
+
 #ifdef __cplusplus
 #define PFX extern "C"
 #else
@@ -48,6 +59,28 @@ struct MoveList {
   uint64_t count;
 };
 
+// Statistics of the weighted agent's last search (see stats.h)
+struct SearchStatistics {
+  uint64_t nodes;
+  uint64_t qnodes;
+  uint64_t tt_probes;
+  uint64_t tt_hits;
+  uint64_t tt_cutoffs;
+  uint64_t beta_cutoffs;
+  uint64_t first_move_cutoffs;
+  uint64_t time_ms;
+  uint32_t depth;
+  uint32_t seldepth;
+  // Nodes of the last iteration over the nodes of the one before
+  float branching_factor;
+  uint64_t eval_probes;
+  uint64_t eval_hits;
+  uint64_t pawn_probes;
+  uint64_t pawn_hits;
+  uint64_t lazy_probes;
+  uint64_t lazy_exits;
+};
+
 #ifdef _WIN32
 #define CFN __declspec(dllexport) PFX
 #else
@@ -64,6 +97,9 @@ struct MoveList {
 CFN uint8_t chess__move_from(void *move);
 CFN uint8_t chess__move_to(void *move);
 CFN enum MoveKind chess__move_kind(void *move);
+// Static exchange evaluation of a move of the game (see see.h), values are
+// the six piece values in the order king, queen, rook, bishop, knight, pawn
+CFN float chess__move_see(void *game, void *move, const float *values);
 
 COBJFN chess__game_create(const char *FEN_str);
 CVOIDFN chess__game_delete(void *game);
@@ -101,6 +137,17 @@ CBOOLFN chess__game_stalemated(void *game);
 CUINTFN chess__game_halfmoves(void *game);
 CUINTFN chess__game_fullmoves(void *game);
 
+// Number of move sequences depth moves long (see perft.h)
+CFN uint64_t chess__game_perft(void *game, uint32_t depth);
+
+// The game as a FEN string, returns its length (the buffer may be too short,
+// see chess__weighted_agent_stats_json)
+CFN uint32_t chess__game_fen(void *game, char *buffer, uint32_t size);
+// Zobrist hash of the game
+CFN uint64_t chess__game_hash(void *game);
+// A copy of the game packed into a dataset record and unpacked (see dataset.h)
+COBJFN chess__game_repack(void *game);
+
 CFN float chess__game_evaluation(void *game, enum ChessTeam team, void* agent);
 CFN float chess__game_advantage(void *game, enum ChessTeam team, void* agent);
 
@@ -111,9 +158,46 @@ CFN void chess__delete_move(void* move);
 
 CFN void* chess__create_weighted_agent();
 CFN void* chess__create_random_agent();
+// Loads the network from a file (see nnue.h), or uses a material-only
+// network when path is NULL. Returns NULL if the file can't be loaded
+CFN void* chess__create_nnue_agent(const char* path);
 
 CFN void chess__delete_weighted_agent(void* agent);
 CFN void chess__delete_random_agent(void* agent);
+CFN void chess__delete_nnue_agent(void* agent);
+
+// Number of threads the weighted agent searches with (Lazy SMP)
+CFN void chess__weighted_agent_set_threads(void* agent, uint32_t threads);
+CFN void chess__weighted_agent_set_feature(void* agent, enum SearchFeature feature, bool enabled);
+
+// Writes the principal variation of the agent's last search as
+// space-separated moves (e2e4 e7e5 ...) into buffer, returns the full length
+CFN uint32_t chess__weighted_agent_pv(void* agent, char* buffer, uint32_t size);
+
+CFN struct SearchStatistics chess__weighted_agent_stats(void* agent);
+// Same as chess__weighted_agent_pv, but with the last search's statistics as
+// a line of JSON, iterations included
+CFN uint32_t chess__weighted_agent_stats_json(void* agent, char* buffer, uint32_t size);
+// Print the statistics of every move as a line of JSON to stderr
+CFN void chess__weighted_agent_log_stats(void* agent, bool enabled);
+// Size of the evaluation cache in megabytes, 0 disables it
+CFN void chess__weighted_agent_set_eval_cache(void* agent, uint32_t megabytes);
+// Size of the pawn structure hash table in megabytes, 0 disables it
+CFN void chess__weighted_agent_set_pawn_hash(void* agent, uint32_t megabytes);
+// Lazy evaluation of the leaves (see Weighted::leaf_eval)
+CFN void chess__weighted_agent_set_lazy_eval(void* agent, bool enabled);
+
+// Pondering (see ponder.h)
+// Starts searching the reply the agent expects after its own move, game is
+// the position right after that move. Returns NULL when there is nothing
+// to ponder on. The agent must not be used while it ponders.
+CFN void* chess__ponder_start(void* game, void* agent);
+// The opponent has moved, game is the resulting position. On a ponder hit
+// the search is finished and its move returned (delete with chess__delete_move),
+// on a miss NULL is returned. Either way pondering is over.
+CFN void* chess__ponder_hit(void* ponder, void* game);
+// Aborts pondering (if still running) and frees the ponderer
+CFN void chess__ponder_stop(void* ponder);
 
 
 #undef CFN
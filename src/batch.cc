@@ -0,0 +1,406 @@
+#include "./batch.h"
+#include "./internal.h"
+#include "./pst.h"
+#include "./simd.h"
+#include <limits>
+
+using namespace chess;
+using namespace chess::batch;
+
+namespace {
+
+constexpr uint64_t FILE_A = 0x0101010101010101ULL;
+constexpr uint64_t FILE_H = FILE_A << 7;
+constexpr uint64_t row(int n) { return 0xFFULL << (8 * (n - 1)); }
+
+// Branch-free population count, which the vectorizer can handle
+// (std::popcount only vectorizes with AVX-512 VPOPCNTDQ)
+inline int popcount(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  x += x >> 8;
+  x += x >> 16;
+  x += x >> 32;
+  return (int)(x & 0x7F);
+}
+inline uint64_t north_fill(uint64_t x) {
+  x |= x << 8;
+  x |= x << 16;
+  return x | (x << 32);
+}
+inline uint64_t south_fill(uint64_t x) {
+  x |= x >> 8;
+  x |= x >> 16;
+  return x | (x >> 32);
+}
+// The squares left and right of x
+inline uint64_t adjacent(uint64_t x) {
+  return ((x >> 1) & ~FILE_H) | ((x << 1) & ~FILE_A);
+}
+
+// Squares scoring 2, 6 and 10 in evaluators::center_ctrl_scores
+struct CenterRings {
+  uint64_t r2 = 0, r6 = 0, r10 = 0;
+};
+const CenterRings &center_rings() {
+  static CenterRings rings = []() {
+    CenterRings r;
+    for (int i = 0; i < 64; i++) {
+      auto score = evaluators::center_ctrl_scores[i];
+      if (score == 2)
+        r.r2 |= 1ULL << i;
+      else if (score == 6)
+        r.r6 |= 1ULL << i;
+      else if (score == 10)
+        r.r10 |= 1ULL << i;
+    }
+    return r;
+  }();
+  return rings;
+}
+
+//
+// Attack maps and piece-square sums
+// both look tables up per piece, so each lane is walked piece by piece
+//
+void lookups(const Positions &p, Features &f, size_t begin, size_t end) {
+  using Kind = Game::PieceKind;
+  const Kind KINDS[] = {Kind::Pawn, Kind::Bishop, Kind::Rook,
+                        Kind::Knight, Kind::Queen, Kind::King};
+
+  for (size_t i = begin; i < end; i++) {
+    uint64_t occupancy[2];
+    occupancy[(int)Game::Team::White] = p.whites[i];
+    occupancy[(int)Game::Team::Black] = p.blacks[i];
+    Bitboard world = p.whites[i] | p.blacks[i];
+    auto stage = p.stage[i] == Game::GameStage::Endgame ? Game::GameStage::Endgame
+                                                        : Game::GameStage::MidGame;
+
+    for (auto team : {Game::Team::White, Game::Team::Black}) {
+      Bitboard friends = occupancy[(int)team];
+      // Only the team to move can take en passant (see fetch_piece_nocache)
+      Bitboard enpassant = p.to_move[i] == (uint8_t)team ? p.enpassant[i] : 0;
+      Bitboard attacks;
+
+      for (auto kind : KINDS) {
+        Bitboard pieces = p.of(kind)[i] & occupancy[(int)team];
+        auto &table = piece_square_tables::scoring_table(team, kind, stage);
+        int32_t pst = 0;
+        while (pieces) {
+          auto sq = pieces.popbit();
+          Bitboard pos = 1ULL << sq;
+          pst += table[sq];
+          switch (kind) {
+#define MOVES(k)                                                               \
+  case k:                                                                      \
+    attacks |= internal::get_pseudolegal_moves<k>(pos, team, friends, world, enpassant); \
+    break;
+            MOVES(Kind::Pawn)
+            MOVES(Kind::Bishop)
+            MOVES(Kind::Rook)
+            MOVES(Kind::Knight)
+            MOVES(Kind::Queen)
+            MOVES(Kind::King)
+#undef MOVES
+          }
+        }
+        f.column(Features::Positioning + (int)kind, team)[i] = pst;
+      }
+      f.attacks[(int)team][i] = (uint64_t)attacks;
+    }
+  }
+}
+
+// out = popcount(a & b & c)
+SIMD_KERNEL void count(const uint64_t *__restrict a, const uint64_t *__restrict b,
+                       const uint64_t *__restrict c, float *__restrict out, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    out[i] = popcount(a[i] & b[i] & c[i]);
+}
+
+// Team dependent masks and shifts of pawn_terms,
+// so that the kernel has no branches
+struct PawnDirection {
+  uint64_t developed[4]; // rows 1, 2, 3 and 4 squares ahead of the pawns' origin
+  int up, down;          // shifts towards the promotion row
+  uint64_t white;        // all ones for white
+
+  explicit PawnDirection(bool is_white)
+      : developed{is_white ? row(3) : row(6), is_white ? row(4) : row(5),
+                  is_white ? row(5) : row(4), is_white ? row(6) : row(3)},
+        up(is_white ? 8 : 0), down(is_white ? 0 : 8), white(is_white ? ~0ULL : 0) {}
+};
+
+SIMD_KERNEL void pawn_terms(const uint64_t *__restrict ours, const uint64_t *__restrict theirs,
+                            const uint64_t *__restrict pawns, const uint64_t *__restrict kings,
+                            PawnDirection dir, float *__restrict development,
+                            float *__restrict king_front, float *__restrict passed,
+                            float *__restrict isolated, float *__restrict doubled, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint64_t own = pawns[i] & ours[i];
+    uint64_t enemy = pawns[i] & theirs[i];
+    uint64_t king = kings[i] & ours[i];
+
+    // Developed by 1, 2, 3 and 4 rows scores 1, 4, 8 and 12
+    development[i] = popcount(own & dir.developed[0]) + 4 * popcount(own & dir.developed[1]) +
+                     8 * popcount(own & dir.developed[2]) + 12 * popcount(own & dir.developed[3]);
+
+    uint64_t front = (king << dir.up) >> dir.down;
+    front |= adjacent(front);
+    king_front[i] = popcount(front & own);
+
+    // Every square an enemy pawn could still meet a pawn of ours on
+    uint64_t span = (south_fill(enemy >> 8) & dir.white) | (north_fill(enemy << 8) & ~dir.white);
+    span |= adjacent(span);
+    passed[i] = popcount(own & ~span);
+
+    uint64_t files = south_fill(north_fill(own));
+    isolated[i] = popcount(own & ~adjacent(files));
+    doubled[i] = popcount(own) - popcount(files & row(1));
+  }
+}
+
+SIMD_KERNEL void board_terms(const uint64_t *__restrict ours, const uint64_t *__restrict theirs,
+                             const uint64_t *__restrict kings,
+                             const uint64_t *__restrict our_attacks,
+                             const uint64_t *__restrict their_attacks, float res,
+                             uint64_t r2, uint64_t r6, uint64_t r10,
+                             float *__restrict check, float *__restrict mobility,
+                             float *__restrict center, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    // Same as evaluators::check, where res is 1 for white and -1 for black
+    int we_are_checked = (their_attacks[i] & kings[i] & ours[i]) != 0;
+    int they_are_checked = (our_attacks[i] & kings[i] & theirs[i]) != 0;
+    int white_checked = res > 0 ? we_are_checked : they_are_checked;
+    int black_checked = res > 0 ? they_are_checked : we_are_checked;
+    check[i] = white_checked ? -res : black_checked ? res : 0;
+
+    mobility[i] = popcount(ours[i]);
+
+    uint64_t controlled = ours[i] | (our_attacks[i] & ~their_attacks[i]);
+    center[i] = 2 * popcount(controlled & r2) + 6 * popcount(controlled & r6) +
+                10 * popcount(controlled & r10);
+  }
+}
+
+// The weights of a team's terms, gathered for the kernel
+struct TermColumns {
+  const float *check, *mobility, *development, *king_front, *passed, *isolated,
+      *doubled, *center;
+  const float *material[6], *their_material[6], *positioning[6], *attacked[6],
+      *covered[6];
+
+  TermColumns(const Features &f, Game::Team team, size_t begin) {
+    auto enemy = team == Game::Team::White ? Game::Team::Black : Game::Team::White;
+    auto col = [&](int term, Game::Team t) { return f.column(term, t) + begin; };
+    check = col(Features::Check, team);
+    mobility = col(Features::Mobility, team);
+    development = col(Features::Development, team);
+    king_front = col(Features::KingFront, team);
+    passed = col(Features::Passed, team);
+    isolated = col(Features::Isolated, team);
+    doubled = col(Features::Doubled, team);
+    center = col(Features::CenterControl, team);
+    for (int k = 0; k < 6; k++) {
+      material[k] = col(Features::Material + k, team);
+      their_material[k] = col(Features::Material + k, enemy);
+      positioning[k] = col(Features::Positioning + k, team);
+      attacked[k] = col(Features::Attacked + k, team);
+      covered[k] = col(Features::Covered + k, team);
+    }
+  }
+};
+
+// A multistage weight, looked up per lane by Game::GameStage
+// (a gather, where branching on the stage would stop the vectorizer)
+struct StageSelect {
+  float v[3];
+  StageSelect(const evaluators::MultistageEvaluationWeight &w)
+      : v{w.opening, w.midgame, w.endgame} {}
+  float operator()(uint8_t s) const { return v[s]; }
+};
+
+//
+// Mirrors Weighted::weightedsum term by term, in the same order,
+// so that the sums are exactly the same
+//
+SIMD_KERNEL void weigh(const TermColumns t, const uint8_t *__restrict stage,
+                       const agents::Weighted::EvaluatorWeights &w,
+                       float *__restrict out, size_t n) {
+  using Kind = Game::PieceKind;
+  const evaluators::PerPiece values = w.values;
+  const evaluators::PerPiece positions = w.positions;
+  const StageSelect w_check = w.check, w_mobility = w.mobility, w_vulnerability = w.vulnerability,
+                    w_pawn_devel = w.pawn_devel, w_positioning = w.positioning, w_material = w.material,
+                    w_king_front_pawns = w.king_front_pawns, w_center_control = w.center_control,
+                    w_protected = w.protected_pieces, w_passed = w.passed_pawns,
+                    w_isolated = w.isolated_pawns, w_doubled = w.doubled_pawns;
+
+  for (size_t i = 0; i < n; i++) {
+    auto s = stage[i];
+#define at(column, kind) t.column[(int)Kind::kind][i]
+    float vulnerability = -(at(attacked, King) * values.king + at(attacked, Queen) * values.queen +
+                            at(attacked, Knight) * values.knight + at(attacked, Bishop) * values.bishop +
+                            at(attacked, Rook) * values.rook + at(attacked, Pawn) * values.pawn);
+    float positioning = at(positioning, Pawn) * positions.pawn + at(positioning, King) * positions.king +
+                        at(positioning, Queen) * positions.queen + at(positioning, Rook) * positions.rook +
+                        at(positioning, Bishop) * positions.bishop + at(positioning, Knight) * positions.knight;
+    float ours = at(material, Queen) * values.queen + at(material, Bishop) * values.bishop +
+                 at(material, Rook) * values.rook + at(material, Knight) * values.knight +
+                 at(material, Pawn) * values.pawn;
+    float theirs = at(their_material, Queen) * values.queen + at(their_material, Bishop) * values.bishop +
+                   at(their_material, Rook) * values.rook + at(their_material, Knight) * values.knight +
+                   at(their_material, Pawn) * values.pawn;
+    // evaluators::covered_pieces sums into an int
+    int covered = 0;
+    covered += at(covered, King) * values.king;
+    covered += at(covered, Queen) * values.queen;
+    covered += at(covered, Rook) * values.rook;
+    covered += at(covered, Knight) * values.knight;
+    covered += at(covered, Bishop) * values.bishop;
+    covered += at(covered, Pawn) * values.pawn;
+#undef at
+
+    float check = t.check[i] * w_check(s);
+    float mobility = t.mobility[i] * w_mobility(s);
+    vulnerability *= w_vulnerability(s);
+    float pawn_devel = t.development[i] * w_pawn_devel(s);
+    positioning *= w_positioning(s);
+    float material = (ours - theirs) * w_material(s);
+    float king_front_pawns = t.king_front[i] * w_king_front_pawns(s);
+    float center_control = t.center[i] * w_center_control(s);
+    float protection = (float)covered * w_protected(s);
+    float pawn_structure = t.passed[i] * w_passed(s) - t.isolated[i] * w_isolated(s) -
+                           t.doubled[i] * w_doubled(s);
+    float misc_contributors = 0;
+
+    out[i] = check + mobility + vulnerability + pawn_devel + positioning + material +
+             king_front_pawns + center_control + protection + pawn_structure + misc_contributors;
+  }
+}
+
+} // namespace
+
+void Positions::reserve(size_t n) {
+  for (auto *v : {&whites, &blacks, &pawns, &bishops, &rooks, &knights, &queens, &kings, &enpassant})
+    v->reserve(n);
+  for (auto *v : {&to_move, &stage, &state})
+    v->reserve(n);
+}
+
+void Positions::clear() {
+  for (auto *v : {&whites, &blacks, &pawns, &bishops, &rooks, &knights, &queens, &kings, &enpassant})
+    v->clear();
+  for (auto *v : {&to_move, &stage, &state})
+    v->clear();
+}
+
+void Positions::push(const Game &game) {
+  auto &b = game.positions;
+  whites.push_back((uint64_t)b.whites);
+  blacks.push_back((uint64_t)b.blacks);
+  pawns.push_back((uint64_t)b.pawns);
+  bishops.push_back((uint64_t)b.bishops);
+  rooks.push_back((uint64_t)b.rooks);
+  knights.push_back((uint64_t)b.knights);
+  queens.push_back((uint64_t)b.queens);
+  kings.push_back((uint64_t)b.kings);
+  enpassant.push_back((uint64_t)game.enpassant);
+  to_move.push_back((uint8_t)(game.state == Game::State::BlackToMove ? Game::Team::Black
+                                                                    : Game::Team::White));
+  stage.push_back((uint8_t)game.stage);
+  state.push_back((uint8_t)game.state);
+}
+
+const std::vector<uint64_t> &Positions::of(Game::PieceKind kind) const {
+  switch (kind) {
+  case Game::PieceKind::Pawn:
+    return pawns;
+  case Game::PieceKind::Bishop:
+    return bishops;
+  case Game::PieceKind::Rook:
+    return rooks;
+  case Game::PieceKind::Knight:
+    return knights;
+  case Game::PieceKind::Queen:
+    return queens;
+  default:
+    return kings;
+  }
+}
+
+void Features::resize(size_t n) {
+  count = n;
+  columns.resize(TERMS * 2 * n);
+  for (auto &a : attacks)
+    a.resize(n);
+}
+
+void chess::batch::extract(const Positions &p, Features &f) {
+  f.resize(p.size());
+  auto &rings = center_rings();
+
+  for (size_t begin = 0; begin < p.size(); begin += BLOCK) {
+    auto end = std::min(begin + BLOCK, p.size());
+    auto n = end - begin;
+    lookups(p, f, begin, end);
+
+    for (auto team : {Game::Team::White, Game::Team::Black}) {
+      auto enemy = team == Game::Team::White ? Game::Team::Black : Game::Team::White;
+      bool white = team == Game::Team::White;
+      auto ours = (white ? p.whites : p.blacks).data() + begin;
+      auto theirs = (white ? p.blacks : p.whites).data() + begin;
+      auto our_attacks = f.attacks[(int)team].data() + begin;
+      auto their_attacks = f.attacks[(int)enemy].data() + begin;
+      auto col = [&](int term) { return f.column(term, team) + begin; };
+
+      for (int k = 0; k < 6; k++) {
+        auto pieces = p.of((Game::PieceKind)k).data() + begin;
+        count(ours, pieces, ours, col(Features::Material + k), n);
+        count(ours, pieces, their_attacks, col(Features::Attacked + k), n);
+        count(ours, pieces, our_attacks, col(Features::Covered + k), n);
+      }
+      pawn_terms(ours, theirs, p.pawns.data() + begin, p.kings.data() + begin, PawnDirection(white),
+                 col(Features::Development), col(Features::KingFront), col(Features::Passed),
+                 col(Features::Isolated), col(Features::Doubled), n);
+      board_terms(ours, theirs, p.kings.data() + begin, our_attacks, their_attacks, white ? 1.0f : -1.0f,
+                  rings.r2, rings.r6, rings.r10, col(Features::Check), col(Features::Mobility),
+                  col(Features::CenterControl), n);
+    }
+  }
+}
+
+void chess::batch::weightedsums(const Positions &p, const Features &f,
+                                const agents::Weighted::EvaluatorWeights &weights,
+                                std::vector<float> &white, std::vector<float> &black) {
+  white.resize(p.size());
+  black.resize(p.size());
+  for (size_t begin = 0; begin < p.size(); begin += BLOCK) {
+    auto end = std::min(begin + BLOCK, p.size());
+    weightedsums(p, f, weights, begin, end, white.data() + begin, black.data() + begin);
+  }
+}
+
+void chess::batch::weightedsums(const Positions &p, const Features &f,
+                                const agents::Weighted::EvaluatorWeights &weights, size_t begin,
+                                size_t end, float *white, float *black) {
+  for (size_t from = begin; from < end; from += BLOCK) {
+    auto n = std::min(from + BLOCK, end) - from;
+    weigh(TermColumns(f, Game::Team::White, from), p.stage.data() + from, weights,
+          white + (from - begin), n);
+    weigh(TermColumns(f, Game::Team::Black, from), p.stage.data() + from, weights,
+          black + (from - begin), n);
+  }
+
+  // Finished games, see Weighted::weightedsum
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  for (size_t i = begin; i < end; i++) {
+    if (p.state[i] == Game::State::WhiteWins)
+      white[i - begin] = inf, black[i - begin] = -inf;
+    else if (p.state[i] == Game::State::BlackWins)
+      white[i - begin] = -inf, black[i - begin] = inf;
+    else if (p.state[i] == Game::State::Stalemate)
+      white[i - begin] = black[i - begin] = 0;
+  }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "./game.h"
+#include "./agents/weighted.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Batched evaluation of independent positions
+ *
+ * Training and analysis evaluate large sets of unrelated positions, where
+ * nothing carries over from one position to the next (no accumulators, no
+ * caches). Here the positions are stored as a structure of arrays, one array
+ * per bitboard, and every term of the evaluation is computed for a block of
+ * positions at a time by a small kernel over those arrays.
+ *
+ * The kernels are plain loops the compiler vectorizes. On x86-64 linux they
+ * are also compiled for AVX2 and AVX-512 and the best version is picked when
+ * the library is loaded (see SIMD_KERNEL in simd.h), elsewhere only the
+ * scalar version is built. Attack maps and piece-square sums need table
+ * lookups per piece, those are gathered lane by lane.
+ *
+ * The weighted sums are the same (bit for bit) as Weighted::weightedsum.
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/SIMD_and_SWAR_Techniques
+ * https://www.chessprogramming.org/Population_Count
+ *
+ * */
+namespace chess::batch {
+
+// Positions evaluated together, small enough for a block of
+// every column to stay in the L1 cache
+constexpr size_t BLOCK = 256;
+
+//
+// N positions, one array per bitboard
+//
+struct Positions {
+  std::vector<uint64_t> whites;
+  std::vector<uint64_t> blacks;
+  std::vector<uint64_t> pawns;
+  std::vector<uint64_t> bishops;
+  std::vector<uint64_t> rooks;
+  std::vector<uint64_t> knights;
+  std::vector<uint64_t> queens;
+  std::vector<uint64_t> kings;
+  std::vector<uint64_t> enpassant;
+  // Game::Team
+  std::vector<uint8_t> to_move;
+  // Game::GameStage
+  std::vector<uint8_t> stage;
+  // Game::State
+  std::vector<uint8_t> state;
+
+  size_t size() const { return whites.size(); }
+  void reserve(size_t n);
+  void clear();
+  void push(const Game &game);
+
+  // Bitboard of a kind of piece, indexed by Game::PieceKind
+  const std::vector<uint64_t> &of(Game::PieceKind kind) const;
+};
+
+//
+// The unweighted terms of the evaluation of every position,
+// one column per term and team
+//
+struct Features {
+  enum Term {
+    Check,
+    Mobility,
+    Development,
+    KingFront,
+    Passed,
+    Isolated,
+    Doubled,
+    CenterControl,
+    // One column per Game::PieceKind from here on
+    Material,                    // pieces on the board
+    Positioning = Material + 6,  // piece-square table sums
+    Attacked = Positioning + 6,  // pieces attacked by the enemy
+    Covered = Attacked + 6,      // pieces protected by their own team
+    TERMS = Covered + 6,
+  };
+
+  size_t count = 0;
+  std::vector<float> columns;
+  // Pseudo attack maps, indexed by Game::Team
+  std::array<std::vector<uint64_t>, 2> attacks;
+
+  void resize(size_t n);
+  float *column(int term, Game::Team team) {
+    return columns.data() + (term * 2 + (int)team) * count;
+  }
+  const float *column(int term, Game::Team team) const {
+    return columns.data() + (term * 2 + (int)team) * count;
+  }
+};
+
+// Compute every term for every position
+void extract(const Positions &positions, Features &features);
+
+// Weighted sums of both teams, like Weighted::weightedsums
+void weightedsums(const Positions &positions, const Features &features,
+                  const agents::Weighted::EvaluatorWeights &weights,
+                  std::vector<float> &white, std::vector<float> &black);
+
+// The same for the positions [begin, end) only, into white[0, end - begin)
+// and black[0, end - begin). Weighing the same block for many weight sets
+// in a row keeps its columns in the cache
+void weightedsums(const Positions &positions, const Features &features,
+                  const agents::Weighted::EvaluatorWeights &weights, size_t begin, size_t end,
+                  float *white, float *black);
+
+}; // namespace chess::batch
@@ -0,0 +1,245 @@
+#pragma once
+#include "game.h"
+#include "./agents/weighted.h"
+#include "./batch.h"
+#include "./agents/nnue.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+/*
+
+Benchmarks for the search, these are run from the command line:
+
+  chess bench smp [depth] [FEN]
+  chess bench pruning [depth] [FEN]
+  chess bench batch [depth] [FEN]
+  chess bench nnue [depth] [FEN]
+
+Lazy SMP scaling:
+Searches the same position to a fixed depth with an increasing thread count
+and reports the time it took to reach that depth, and the nodes per second
+across all threads
+
+*/
+
+inline void bench_smp(const chess::Game &game, int depth) {
+  using namespace chess;
+  const int THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32};
+
+  std::cout << "threads\tdepth\ttime(ms)\tnodes\tnps\tmove" << std::endl;
+  for (auto threads : THREAD_COUNTS) {
+    agents::Weighted agent;
+    agent.search_depth = depth;
+    agent.threads = threads;
+
+    auto before = std::chrono::steady_clock::now();
+    auto result = agent.search(game);
+    auto after = std::chrono::steady_clock::now();
+
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(after - before).count();
+    auto nps = delta ? result.nodes * 1000000 / delta : 0;
+    std::cout << threads << "\t" << result.depth << "\t" << delta / 1000 << "\t"
+              << result.nodes << "\t" << nps << "\t"
+              << result.bestmove.source_pos.standard_notation()
+              << result.bestmove.target_pos.standard_notation() << std::endl;
+  }
+}
+
+/*
+Pruning statistics:
+Searches the position once with everything enabled, and reports how many
+nodes each selective technique cut (or leaves lazy evaluation cut short),
+and the node count with it disabled
+*/
+inline void bench_pruning(const chess::Game &game, int depth) {
+  using namespace chess;
+
+  auto run = [&](const char *name, auto disable) {
+    agents::Weighted agent;
+    agent.search_depth = depth;
+    disable(agent);
+    auto before = std::chrono::steady_clock::now();
+    auto result = agent.search(game);
+    auto after = std::chrono::steady_clock::now();
+    auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(after - before).count();
+    std::cout << name << "\t" << result.nodes << "\t" << delta << std::endl;
+    return result;
+  };
+
+  std::cout << "disabled\tnodes\ttime(ms)" << std::endl;
+  auto all = run("none", [](auto &) {});
+  run("null_move", [](auto &a) { a.pruning.null_move = false; });
+  run("lmr", [](auto &a) { a.pruning.late_move_reductions = false; });
+  run("futility", [](auto &a) { a.pruning.futility = false; });
+  run("razoring", [](auto &a) { a.pruning.razoring = false; });
+  run("see", [](auto &a) { a.pruning.see_pruning = false; });
+  run("lazy_eval", [](auto &a) { a.lazy_eval = false; });
+
+  auto &p = all.pruned;
+  std::cout << "\nnull move: " << p.null_move_cutoffs << " / " << p.null_move_tries << " cutoffs\n"
+            << "lmr: " << p.lmr_reductions << " reduced, " << p.lmr_researches << " re-searched\n"
+            << "futility: " << p.futility_pruned << " moves pruned\n"
+            << "razoring: " << p.razor_cutoffs << " / " << p.razor_tries << " cutoffs\n"
+            << "delta: " << p.delta_pruned << " captures pruned\n"
+            << "see: " << p.see_pruned << " losing captures pruned\n"
+            << "lazy eval: " << all.stats.lazy_exits << " / " << all.stats.lazy_probes << " leaves" << std::endl;
+}
+
+// Every position up to depth plies away from game, breadth first
+inline std::vector<chess::Game> reachable_positions(const chess::Game &game, int depth, size_t limit) {
+  using namespace chess;
+  std::vector<Game> games;
+  std::vector<Game> frontier = {game};
+  for (int ply = 0; ply <= depth && !frontier.empty() && games.size() < limit; ply++) {
+    std::vector<Game> next;
+    for (auto &g : frontier) {
+      if (games.size() >= limit)
+        break;
+      games.push_back(g);
+      if (g.state != Game::State::WhiteToMove && g.state != Game::State::BlackToMove)
+        continue;
+      for (auto &m : g.movelist(g.current_active_team())) {
+        if (next.size() >= limit)
+          break;
+        next.push_back(g);
+        next.back().make_move(m);
+      }
+    }
+    frontier = std::move(next);
+  }
+  return games;
+}
+
+/*
+Batched evaluation:
+Evaluates every position up to `depth` plies away from the given one (at
+most 20000 of them), one Game at a time as the search does and then as a
+single batch::Positions, and reports the positions evaluated per second
+*/
+inline void bench_batch(const chess::Game &game, int depth) {
+  using namespace chess;
+  constexpr size_t LIMIT = 20000;
+  constexpr int ROUNDS = 20;
+
+  auto games = reachable_positions(game, depth, LIMIT);
+
+  agents::Weighted agent;
+  batch::Positions positions;
+  positions.reserve(games.size());
+  for (auto &g : games)
+    positions.push(g);
+
+  auto time = [&](const char *name, auto evaluate) {
+    auto before = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+      evaluate();
+    auto after = std::chrono::steady_clock::now();
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(after - before).count();
+    auto evaluated = (uint64_t)games.size() * ROUNDS;
+    std::cout << name << "\t" << games.size() << "\t" << delta / 1000 << "\t"
+              << (delta ? evaluated * 1000000 / delta : 0) << std::endl;
+  };
+
+  std::vector<float> white(games.size()), black(games.size());
+  std::cout << "mode\tpositions\ttime(ms)\tpositions/s" << std::endl;
+  time("scalar", [&]() {
+    for (size_t i = 0; i < games.size(); i++) {
+      auto sums = agent.weightedsums(games[i], PawnStructure::evaluate(games[i]));
+      white[i] = sums[(int)Game::Team::White];
+      black[i] = sums[(int)Game::Team::Black];
+    }
+  });
+
+  batch::Features features;
+  std::vector<float> batch_white, batch_black;
+  time("batch", [&]() {
+    batch::extract(positions, features);
+    batch::weightedsums(positions, features, agent.weights, batch_white, batch_black);
+  });
+
+  // Both have to agree exactly
+  size_t mismatches = 0;
+  for (size_t i = 0; i < games.size(); i++)
+    mismatches += std::memcmp(&white[i], &batch_white[i], sizeof(float)) ||
+                  std::memcmp(&black[i], &batch_black[i], sizeof(float));
+  std::cout << "mismatches: " << mismatches << std::endl;
+}
+
+/*
+NNUE evaluation:
+For every position up to `depth` plies away from the given one (at most
+20000 of them), evaluates its children once with a full refresh of the
+accumulator and once with an incremental update from the parent's, and
+reports the evaluations per second of both. Then searches the position
+with the NNUE agent to `depth` plies
+*/
+inline void bench_nnue(const chess::Game &game, int depth) {
+  using namespace chess;
+  constexpr size_t LIMIT = 20000;
+  constexpr int ROUNDS = 20;
+
+  agents::Nnue agent;
+  auto &net = *agent.network;
+
+  // Children keep the deltas of the move leading to them
+  std::vector<nnue::Accumulator> parents;
+  std::vector<size_t> parent_of;
+  std::vector<Game> children;
+  for (auto &g : reachable_positions(game, depth - 1, LIMIT)) {
+    if (g.state != Game::State::WhiteToMove && g.state != Game::State::BlackToMove)
+      continue;
+    parents.emplace_back();
+    nnue::refresh(net, g, parents.back());
+    for (auto &m : g.movelist(g.current_active_team())) {
+      Game child = g;
+      child.deltas.clear();
+      child.make_move(m);
+      if (child.state != Game::State::WhiteToMove && child.state != Game::State::BlackToMove)
+        continue;
+      children.push_back(std::move(child));
+      parent_of.push_back(parents.size() - 1);
+    }
+    if (children.size() >= LIMIT)
+      break;
+  }
+
+  std::vector<nnue::Accumulator> refreshed(children.size()), updated(children.size());
+  int64_t checksum = 0;
+  auto time = [&](const char *name, auto evaluate) {
+    auto before = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+      for (size_t i = 0; i < children.size(); i++)
+        checksum += evaluate(i);
+    auto after = std::chrono::steady_clock::now();
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(after - before).count();
+    auto evaluated = (uint64_t)children.size() * ROUNDS;
+    std::cout << name << "\t" << children.size() << "\t" << delta / 1000 << "\t"
+              << (delta ? evaluated * 1000000 / delta : 0) << std::endl;
+  };
+
+  std::cout << "mode\tpositions\ttime(ms)\tevals/s" << std::endl;
+  time("refresh", [&](size_t i) {
+    nnue::refresh(net, children[i], refreshed[i]);
+    return nnue::evaluate(net, refreshed[i], children[i].current_active_team());
+  });
+  time("update", [&](size_t i) {
+    nnue::update(net, children[i], parents[parent_of[i]], updated[i]);
+    return nnue::evaluate(net, updated[i], children[i].current_active_team());
+  });
+
+  // Both have to agree exactly
+  size_t mismatches = 0;
+  for (size_t i = 0; i < children.size(); i++)
+    mismatches += !(refreshed[i] == updated[i]);
+  std::cout << "mismatches: " << mismatches << " (checksum " << checksum << ")" << std::endl;
+
+  agent.search_depth = depth;
+  auto before = std::chrono::steady_clock::now();
+  auto move = game.get_agent_move(agent);
+  auto after = std::chrono::steady_clock::now();
+  auto delta = std::chrono::duration_cast<std::chrono::microseconds>(after - before).count();
+  std::cout << "\nsearch depth " << depth << ": " << agent.nodes << " nodes, " << delta / 1000 << " ms, "
+            << (delta ? agent.nodes * 1000000 / delta : 0) << " nps, "
+            << move.source_pos.standard_notation() << move.target_pos.standard_notation() << std::endl;
+}
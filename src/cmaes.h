@@ -0,0 +1,287 @@
+#pragma once
+#include "./error.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Covariance matrix adaptation evolution strategy (CMA-ES)
+ *
+ * Samples every generation from a multivariate normal distribution, and
+ * moves its mean towards the best samples. Unlike the mutations of the
+ * genetic algorithm, the step size (sigma) and the shape of the
+ * distribution (the covariance matrix) are learned from the samples that
+ * did well, so that it takes long steps along the directions that keep
+ * paying off and short ones along the rest. Only the ranking of the
+ * samples is used, so the fitness need not be smooth.
+ *
+ * Used through ask (the samples of a generation) and tell (their fitness).
+ * Follows "The CMA Evolution Strategy: A Tutorial" (Hansen), with the
+ * default parameters from there.
+ *
+ * Relavant Docs:
+ * https://arxiv.org/abs/1604.00772
+ * https://en.wikipedia.org/wiki/CMA-ES
+ *
+ * */
+namespace chess::cmaes {
+
+class Optimizer {
+public:
+  // Starts from mean with step size sigma, lambda samples
+  // per generation (the default for the dimension when 0)
+  Optimizer(std::vector<double> mean, double sigma, int lambda = 0)
+      : n(mean.size()), m(std::move(mean)), step_size(sigma), ps(n), pc(n), C(n * n), B(n * n), D(n, 1),
+        units(n, 1), rng(std::random_device{}()) {
+    this->lambda = lambda > 0 ? lambda : 4 + (int)(3 * std::log((double)n));
+    for (size_t i = 0; i < n; i++)
+      C[i * n + i] = B[i * n + i] = 1;
+    configure();
+  }
+
+  // The samples of the current generation
+  const std::vector<std::vector<double>> &ask() {
+    std::normal_distribution<double> normal;
+    samples.assign(lambda, std::vector<double>(n));
+    steps.assign(lambda, std::vector<double>(n));
+    std::vector<double> z(n);
+    for (int k = 0; k < lambda; k++) {
+      for (auto &v : z)
+        v = normal(rng);
+      // y = B D z, x = m + sigma y
+      for (size_t i = 0; i < n; i++) {
+        double y = 0;
+        for (size_t j = 0; j < n; j++)
+          y += B[i * n + j] * D[j] * z[j];
+        steps[k][i] = y;
+        samples[k][i] = m[i] + step_size * y;
+      }
+    }
+    return samples;
+  }
+
+  // Fitness of each sample of ask, higher is better
+  void tell(const std::vector<double> &fitness) {
+    if (fitness.size() != samples.size())
+      throw chess::Error("CMA-ES was told the fitness of the wrong number of samples");
+    std::vector<int> order(lambda);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return fitness[a] > fitness[b]; });
+
+    // The new mean, and the (weighted) step it took
+    std::vector<double> yw(n);
+    for (int k = 0; k < mu; k++)
+      for (size_t i = 0; i < n; i++)
+        yw[i] += weights[k] * steps[order[k]][i];
+    for (size_t i = 0; i < n; i++)
+      m[i] += step_size * yw[i];
+
+    // Step size path, along C^-1/2 yw = B D^-1 B^T yw
+    std::vector<double> bt(n);
+    for (size_t j = 0; j < n; j++) {
+      for (size_t i = 0; i < n; i++)
+        bt[j] += B[i * n + j] * yw[i];
+      bt[j] /= D[j];
+    }
+    double ps_norm = 0;
+    for (size_t i = 0; i < n; i++) {
+      double v = 0;
+      for (size_t j = 0; j < n; j++)
+        v += B[i * n + j] * bt[j];
+      ps[i] = (1 - cs) * ps[i] + std::sqrt(cs * (2 - cs) * mueff) * v;
+      ps_norm += ps[i] * ps[i];
+    }
+    ps_norm = std::sqrt(ps_norm);
+    gen++;
+
+    // Stalls the covariance path while the step size path is too long
+    bool hs = ps_norm / std::sqrt(1 - std::pow(1 - cs, 2.0 * gen)) < (1.4 + 2.0 / (n + 1)) * chi_n;
+    for (size_t i = 0; i < n; i++)
+      pc[i] = (1 - cc) * pc[i] + (hs ? std::sqrt(cc * (2 - cc) * mueff) : 0) * yw[i];
+
+    // Rank one update from the path, rank mu update from the best steps
+    double decay = 1 - c1 - cmu + (hs ? 0 : c1 * cc * (2 - cc));
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j <= i; j++) {
+        double rank_mu = 0;
+        for (int k = 0; k < mu; k++)
+          rank_mu += weights[k] * steps[order[k]][i] * steps[order[k]][j];
+        double c = decay * C[i * n + j] + c1 * pc[i] * pc[j] + cmu * rank_mu;
+        C[i * n + j] = C[j * n + i] = c;
+      }
+    }
+
+    step_size *= std::exp((cs / ds) * (ps_norm / chi_n - 1));
+    decompose();
+  }
+
+  int generation() const { return gen; }
+  int population() const { return lambda; }
+  double sigma() const { return step_size; }
+  const std::vector<double> &mean() const { return m; }
+  // How much longer the longest axis of the distribution is than the shortest
+  double axis_ratio() const {
+    auto [lo, hi] = std::minmax_element(D.begin(), D.end());
+    return *hi / *lo;
+  }
+
+  // What one unit of each coordinate stands for, to the caller (1 unless
+  // set). The optimizer only stores them with its state, so that a resumed
+  // run can check that it reads the coordinates the same way
+  const std::vector<double> &scales() const { return units; }
+  void set_scales(std::vector<double> scales) {
+    if (scales.size() != n)
+      throw chess::Error("CMA-ES was given the scales of the wrong number of coordinates");
+    units = std::move(scales);
+  }
+
+  //
+  // The state is stored as text: "CMAES", the version, the dimension, the
+  // population, the generation and sigma, followed by the mean, both paths,
+  // the covariance matrix (by rows) and the scales
+  //
+  // Written next to the file and renamed over it, a run stopped while
+  // saving keeps the previous state
+  //
+  void save(const std::string &path) const {
+    auto temporary = path + ".tmp";
+    {
+      std::ofstream out(temporary);
+      if (!out)
+        throw chess::Error("Could not create CMA-ES state file: " + temporary);
+      out.precision(17);
+      out << "CMAES " << VERSION << " " << n << " " << lambda << " " << gen << " " << step_size << "\n";
+      for (auto *v : {&m, &ps, &pc, &C, &units}) {
+        for (auto x : *v)
+          out << x << " ";
+        out << "\n";
+      }
+      if (!out.flush())
+        throw chess::Error("Could not write CMA-ES state file: " + temporary);
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+      throw chess::Error("Could not replace CMA-ES state file: " + path);
+  }
+
+  static Optimizer load(const std::string &path) {
+    std::ifstream in(path);
+    if (!in)
+      throw chess::Error("Could not open CMA-ES state file: " + path);
+    std::string magic;
+    int version, lambda, gen;
+    size_t n;
+    double sigma;
+    if (!(in >> magic >> version >> n >> lambda >> gen >> sigma) || magic != "CMAES")
+      throw chess::Error("Not a CMA-ES state file: " + path);
+    if (version != VERSION)
+      throw chess::Error("Unsupported CMA-ES state version " + std::to_string(version) + ": " + path);
+
+    Optimizer opt(std::vector<double>(n), sigma, lambda);
+    opt.gen = gen;
+    for (auto *v : {&opt.m, &opt.ps, &opt.pc, &opt.C, &opt.units})
+      for (auto &x : *v)
+        if (!(in >> x))
+          throw chess::Error("Truncated CMA-ES state file: " + path);
+    opt.decompose();
+    return opt;
+  }
+
+private:
+  static constexpr int VERSION = 2;
+
+  void configure() {
+    mu = lambda / 2;
+    weights.resize(mu);
+    for (int k = 0; k < mu; k++)
+      weights[k] = std::log(mu + 0.5) - std::log(k + 1.0);
+    double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+    double squares = 0;
+    for (auto &w : weights) {
+      w /= sum;
+      squares += w * w;
+    }
+    mueff = 1 / squares;
+
+    double dim = n;
+    cs = (mueff + 2) / (dim + mueff + 5);
+    ds = 1 + 2 * std::max(0.0, std::sqrt((mueff - 1) / (dim + 1)) - 1) + cs;
+    cc = (4 + mueff / dim) / (dim + 4 + 2 * mueff / dim);
+    c1 = 2 / ((dim + 1.3) * (dim + 1.3) + mueff);
+    cmu = std::min(1 - c1, 2 * (mueff - 2 + 1 / mueff) / ((dim + 2) * (dim + 2) + mueff));
+    chi_n = std::sqrt(dim) * (1 - 1 / (4 * dim) + 1 / (21 * dim * dim));
+  }
+
+  //
+  // C = B D^2 B^T, by cyclic Jacobi rotations
+  // (n is small, the fitness evaluations cost far more)
+  //
+  void decompose() {
+    std::vector<double> a = C;
+    std::fill(B.begin(), B.end(), 0);
+    for (size_t i = 0; i < n; i++)
+      B[i * n + i] = 1;
+
+    for (int sweep = 0; sweep < 50; sweep++) {
+      double off = 0;
+      for (size_t p = 0; p < n; p++)
+        for (size_t q = p + 1; q < n; q++)
+          off += a[p * n + q] * a[p * n + q];
+      if (off < 1e-30)
+        break;
+
+      for (size_t p = 0; p < n; p++) {
+        for (size_t q = p + 1; q < n; q++) {
+          double apq = a[p * n + q];
+          if (std::abs(apq) < 1e-300)
+            continue;
+          double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+          double t = (theta >= 0 ? 1 : -1) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+          double c = 1 / std::sqrt(t * t + 1), s = t * c;
+          for (size_t k = 0; k < n; k++) {
+            double akp = a[k * n + p], akq = a[k * n + q];
+            a[k * n + p] = c * akp - s * akq;
+            a[k * n + q] = s * akp + c * akq;
+          }
+          for (size_t k = 0; k < n; k++) {
+            double apk = a[p * n + k], aqk = a[q * n + k];
+            a[p * n + k] = c * apk - s * aqk;
+            a[q * n + k] = s * apk + c * aqk;
+          }
+          for (size_t k = 0; k < n; k++) {
+            double bkp = B[k * n + p], bkq = B[k * n + q];
+            B[k * n + p] = c * bkp - s * bkq;
+            B[k * n + q] = s * bkp + c * bkq;
+          }
+        }
+      }
+    }
+    // Rounding can leave tiny negative eigenvalues
+    for (size_t i = 0; i < n; i++)
+      D[i] = std::sqrt(std::max(a[i * n + i], 1e-20));
+  }
+
+  size_t n;
+  int lambda, mu;
+  std::vector<double> weights;
+  double mueff, cs, ds, cc, c1, cmu, chi_n;
+
+  std::vector<double> m;
+  double step_size;
+  // Evolution paths of the step size and of the covariance
+  std::vector<double> ps, pc;
+  // Covariance, and its eigenvectors (columns of B) and
+  // the square roots of its eigenvalues, n x n by rows
+  std::vector<double> C, B, D;
+  std::vector<double> units;
+  int gen = 0;
+
+  std::vector<std::vector<double>> samples, steps;
+  std::mt19937_64 rng;
+};
+
+}; // namespace chess::cmaes
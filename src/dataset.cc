@@ -0,0 +1,363 @@
+#include "./dataset.h"
+#include "./error.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace chess;
+using namespace chess::dataset;
+
+namespace {
+
+constexpr char MAGIC[4] = {'C', 'P', 'O', 'S'};
+constexpr uint32_t VERSION = 1;
+// Text files are parsed this much at a time
+constexpr size_t CHUNK_SIZE = 16 << 20;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t count;
+};
+static_assert(sizeof(Header) == 16);
+
+void check_endianness() {
+  if constexpr (std::endian::native != std::endian::little)
+    throw chess::Error("Datasets can only be read and written on little endian machines");
+}
+
+const Header &check_header(const void *data, size_t size, const std::string &path) {
+  if (size < sizeof(Header))
+    throw chess::Error("Truncated dataset file: " + path);
+  auto &header = *static_cast<const Header *>(data);
+  if (std::memcmp(header.magic, MAGIC, 4) != 0)
+    throw chess::Error("Not a dataset file: " + path);
+  if (header.version != VERSION)
+    throw chess::Error("Unsupported dataset version " + std::to_string(header.version) + ": " + path);
+  if ((size - sizeof(Header)) / sizeof(PackedPosition) < header.count)
+    throw chess::Error("Truncated dataset file: " + path);
+  return header;
+}
+
+Bitboard &board_of(Game::PositionalInfo &p, Game::PieceKind kind) {
+  switch (kind) {
+  case Game::PieceKind::Pawn:
+    return p.pawns;
+  case Game::PieceKind::Bishop:
+    return p.bishops;
+  case Game::PieceKind::Rook:
+    return p.rooks;
+  case Game::PieceKind::Knight:
+    return p.knights;
+  case Game::PieceKind::Queen:
+    return p.queens;
+  default:
+    return p.kings;
+  }
+}
+
+Game::PieceKind kind_at(const Game::PositionalInfo &p, Bitboard square) {
+  if (square & p.pawns)
+    return Game::PieceKind::Pawn;
+  if (square & p.bishops)
+    return Game::PieceKind::Bishop;
+  if (square & p.rooks)
+    return Game::PieceKind::Rook;
+  if (square & p.knights)
+    return Game::PieceKind::Knight;
+  if (square & p.queens)
+    return Game::PieceKind::Queen;
+  return Game::PieceKind::King;
+}
+
+// The position and result of a line, false when there is none
+bool parse_line(std::string_view line, std::string_view &position, Result &result) {
+  std::string_view outcome;
+  if (auto bracket = line.rfind('['); bracket != std::string_view::npos) {
+    position = line.substr(0, bracket);
+    outcome = line.substr(bracket + 1, line.find(']', bracket) - bracket - 1);
+    if (outcome == "1.0" || outcome == "1")
+      result = WhiteWin;
+    else if (outcome == "0.5")
+      result = Draw;
+    else if (outcome == "0.0" || outcome == "0")
+      result = BlackWin;
+    else
+      return false;
+  } else if (auto opcode = line.find(" c9 \""); opcode != std::string_view::npos) {
+    position = line.substr(0, opcode);
+    outcome = line.substr(opcode + 5, line.find('"', opcode + 5) - opcode - 5);
+    if (outcome == "1-0")
+      result = WhiteWin;
+    else if (outcome == "1/2-1/2")
+      result = Draw;
+    else if (outcome == "0-1")
+      result = BlackWin;
+    else
+      return false;
+  } else
+    return false;
+  // EPD leaves out the move counters, Game::create fills them in
+  return true;
+}
+
+// A parsed position, with the hash it is deduplicated by
+struct Parsed {
+  uint64_t hash;
+  PackedPosition position;
+};
+
+// Parse every line of text (whole lines only)
+void parse_lines(std::string_view text, std::vector<Parsed> &parsed, size_t &bad) {
+  while (!text.empty()) {
+    auto end = std::min(text.find('\n'), text.size());
+    auto line = text.substr(0, end);
+    text.remove_prefix(std::min(end + 1, text.size()));
+    if (line.find_first_not_of(" \t\r") == std::string_view::npos)
+      continue;
+
+    std::string_view position;
+    Result result;
+    if (!parse_line(line, position, result)) {
+      bad++;
+      continue;
+    }
+    try {
+      auto game = Game::create(position);
+      parsed.push_back({game.zobrist_hash, PackedPosition::pack(game, result)});
+    } catch (const chess::Error &) {
+      bad++;
+    }
+  }
+}
+
+}; // namespace
+
+PackedPosition PackedPosition::pack(const Game &game, Result result) {
+  auto &p = game.positions;
+  PackedPosition packed{};
+  Bitboard occupied = p.whites | p.blacks;
+  if (occupied.count() > 32)
+    throw chess::Error("Too many pieces to pack a position");
+
+  packed.occupancy = (uint64_t)occupied;
+  int i = 0;
+  while (occupied) {
+    Bitboard square = 1ULL << occupied.popbit();
+    uint8_t nibble = (uint8_t)kind_at(p, square) | (square & p.blacks ? 1 << 3 : 0);
+    packed.pieces[i / 2] |= nibble << (i % 2 * 4);
+    i++;
+  }
+
+  packed.fullmoves = std::min<uint32_t>(game.fullmoves, UINT16_MAX);
+  packed.halfmoves = std::min<uint32_t>(game.halfmoves, UINT8_MAX);
+  packed.enpassant = game.enpassant ? game.enpassant.trailing_zeroes() : NO_SQUARE;
+  packed.flags = (game.current_active_team() == Game::Team::Black) | game.castle.wks << 1 | game.castle.wqs << 2 |
+                 game.castle.bks << 3 | game.castle.bqs << 4 | (uint8_t)result << 5;
+  return packed;
+}
+
+Game PackedPosition::unpack() const {
+  Game::PositionalInfo p{};
+  Bitboard occupied = occupancy;
+  int i = 0;
+  while (occupied) {
+    Bitboard square = 1ULL << occupied.popbit();
+    uint8_t nibble = pieces[i / 2] >> (i % 2 * 4) & 0xF;
+    board_of(p, (Game::PieceKind)(nibble & 7)) |= square;
+    (nibble >> 3 ? p.blacks : p.whites) |= square;
+    i++;
+  }
+
+  Game::CastleInfo castle;
+  castle.wks = flags >> 1 & 1;
+  castle.wqs = flags >> 2 & 1;
+  castle.bks = flags >> 3 & 1;
+  castle.bqs = flags >> 4 & 1;
+  Bitboard ep = enpassant == NO_SQUARE ? 0 : 1ULL << enpassant;
+  return Game::create(p, flags & 1 ? Game::Team::Black : Game::Team::White, castle, ep, halfmoves, fullmoves);
+}
+
+void dataset::write(const std::string &path, std::span<const PackedPosition> positions) {
+  check_endianness();
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+    throw chess::Error("Could not create dataset file: " + path);
+
+  Header header{};
+  std::memcpy(header.magic, MAGIC, 4);
+  header.version = VERSION;
+  header.count = positions.size();
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(positions.data()), positions.size_bytes());
+  if (!out)
+    throw chess::Error("Could not write dataset file: " + path);
+}
+
+Reader::Reader(const std::string &path) {
+  check_endianness();
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw chess::Error("Could not open dataset file: " + path);
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    throw chess::Error("Truncated dataset file: " + path);
+  }
+  mapping_size = info.st_size;
+  mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw chess::Error("Could not map dataset file: " + path);
+  }
+  // Training reads the records front to back
+  madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+
+  try {
+    count = check_header(mapping, mapping_size, path).count;
+  } catch (...) {
+    unmap();
+    throw;
+  }
+  // The header keeps the records 16 byte aligned
+  records = reinterpret_cast<const PackedPosition *>(static_cast<const char *>(mapping) + sizeof(Header));
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw chess::Error("Could not open dataset file: " + path);
+  Header header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    throw chess::Error("Truncated dataset file: " + path);
+  check_header(&header, sizeof(header) + header.count * sizeof(PackedPosition), path);
+  storage.resize(header.count);
+  if (!in.read(reinterpret_cast<char *>(storage.data()), storage.size() * sizeof(PackedPosition)))
+    throw chess::Error("Truncated dataset file: " + path);
+  records = storage.data();
+  count = storage.size();
+#endif
+}
+
+Reader::Reader(std::vector<PackedPosition> positions) : storage(std::move(positions)) {
+  records = storage.data();
+  count = storage.size();
+}
+
+Reader::~Reader() { unmap(); }
+
+Reader::Reader(Reader &&o) noexcept { *this = std::move(o); }
+
+Reader &Reader::operator=(Reader &&o) noexcept {
+  if (this == &o)
+    return *this;
+  unmap();
+  mapping = std::exchange(o.mapping, nullptr);
+  mapping_size = std::exchange(o.mapping_size, 0);
+  // The vector's buffer moves along with it, the pointer stays valid
+  storage = std::move(o.storage);
+  records = std::exchange(o.records, nullptr);
+  count = std::exchange(o.count, 0);
+  return *this;
+}
+
+void Reader::unmap() {
+#ifndef _WIN32
+  if (mapping)
+    munmap(mapping, mapping_size);
+#endif
+  mapping = nullptr;
+  mapping_size = 0;
+}
+
+std::vector<PackedPosition> dataset::parse(const std::string &path, ParseStats *stats, unsigned threads) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw chess::Error("Could not open position file: " + path);
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<PackedPosition> positions;
+  std::unordered_set<uint64_t> seen;
+  ParseStats counts;
+
+  std::vector<char> buffer(CHUNK_SIZE);
+  std::vector<std::vector<Parsed>> parsed(threads);
+  std::vector<size_t> bad(threads);
+  size_t carried = 0;
+  while (true) {
+    in.read(buffer.data() + carried, buffer.size() - carried);
+    size_t filled = carried + in.gcount();
+    bool last = !in;
+
+    // Only whole lines are parsed, the rest is carried over to the next chunk
+    size_t end = filled;
+    if (!last) {
+      auto newline = std::string_view(buffer.data(), filled).rfind('\n');
+      if (newline == std::string_view::npos) {
+        // A line longer than a chunk
+        carried = filled;
+        buffer.resize(buffer.size() * 2);
+        continue;
+      }
+      end = newline + 1;
+    }
+
+    // A slice of the chunk per thread, cut at line ends
+    std::string_view text(buffer.data(), end);
+    std::vector<std::string_view> slices;
+    size_t from = 0;
+    for (unsigned i = 1; i <= threads; i++) {
+      size_t to = i == threads ? text.size() : std::max(from, text.size() * i / threads);
+      to = std::min(text.find('\n', to), text.size());
+      slices.push_back(text.substr(from, to - from));
+      from = std::min(to + 1, text.size());
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+      workers.emplace_back(parse_lines, slices[i], std::ref(parsed[i]), std::ref(bad[i]));
+    parse_lines(slices[0], parsed[0], bad[0]);
+    for (auto &worker : workers)
+      worker.join();
+
+    // Merged in file order, so the first of the duplicates is kept
+    for (unsigned i = 0; i < threads; i++) {
+      for (auto &p : parsed[i]) {
+        if (seen.insert(p.hash).second)
+          positions.push_back(p.position);
+        else
+          counts.duplicates++;
+      }
+      parsed[i].clear();
+      counts.skipped += std::exchange(bad[i], 0);
+    }
+
+    carried = filled - end;
+    std::memmove(buffer.data(), buffer.data() + end, carried);
+    if (last)
+      break;
+  }
+
+  if (stats)
+    *stats = counts;
+  return positions;
+}
+
+size_t dataset::convert(const std::string &input, const std::string &output, ParseStats *stats) {
+  auto positions = parse(input, stats);
+  write(output, positions);
+  return positions.size();
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "./game.h"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+ * Packed binary position datasets
+ *
+ * Training evaluates every position of its dataset once per agent, parsing
+ * FEN strings each time costs more than evaluating them. Positions are
+ * converted once instead (see convert) into fixed size records, which are
+ * read straight out of a memory mapped file.
+ *
+ * A record is 32 bytes:
+ *
+ *   occupancy   8 bytes, every occupied square
+ *   pieces     16 bytes, a nibble per occupied square (kind | team << 3),
+ *                        in square order, the low nibble first
+ *   fullmoves   2 bytes
+ *   halfmoves   1 byte
+ *   enpassant   1 byte, the square, or NO_SQUARE
+ *   flags       1 byte, black to move (bit 0), castling rights K Q k q
+ *                       (bits 1-4) and the result (bits 5-6)
+ *   reserved    3 bytes, zeroed
+ *
+ * A file is a small header ("CPOS", the version as a little endian uint32
+ * and the number of records as a little endian uint64) followed by the
+ * records, all little endian.
+ *
+ * */
+namespace chess {
+
+// Result of the game a position was taken from
+enum Result : uint8_t {
+  WhiteWin,
+  BlackWin,
+  Draw,
+};
+
+namespace dataset {
+
+struct PackedPosition {
+  static constexpr uint8_t NO_SQUARE = 0xFF;
+
+  uint64_t occupancy;
+  std::array<uint8_t, 16> pieces;
+  uint16_t fullmoves;
+  uint8_t halfmoves;
+  uint8_t enpassant;
+  uint8_t flags;
+  std::array<uint8_t, 3> reserved;
+
+  static PackedPosition pack(const Game &game, Result result);
+  Game unpack() const;
+  Result result() const { return (Result)((flags >> 5) & 3); }
+};
+static_assert(sizeof(PackedPosition) == 32, "Dataset records must stay 32 bytes");
+
+void write(const std::string &path, std::span<const PackedPosition> positions);
+
+//
+// The records of a dataset file, mapped into memory and read in place.
+// Records built in memory (e.g. from a FEN file) can be wrapped too,
+// so that both are used alike
+//
+class Reader {
+public:
+  explicit Reader(const std::string &path);
+  explicit Reader(std::vector<PackedPosition> positions);
+  ~Reader();
+
+  Reader(Reader &&o) noexcept;
+  Reader &operator=(Reader &&o) noexcept;
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
+  std::span<const PackedPosition> positions() const { return {records, count}; }
+  size_t size() const { return count; }
+  const PackedPosition &operator[](size_t i) const { return records[i]; }
+  const PackedPosition *begin() const { return records; }
+  const PackedPosition *end() const { return records + count; }
+
+private:
+  void unmap();
+
+  // The whole file, when mapped
+  void *mapping = nullptr;
+  size_t mapping_size = 0;
+  // Records built in memory, or read when the file can't be mapped
+  std::vector<PackedPosition> storage;
+
+  const PackedPosition *records = nullptr;
+  size_t count = 0;
+};
+
+// What parse left out
+struct ParseStats {
+  // Lines which couldn't be read
+  size_t skipped = 0;
+  // Positions seen before (by their zobrist hash), only the first is kept
+  size_t duplicates = 0;
+};
+
+//
+// Read positions with results, one per line, in either of the formats
+//
+//   <fen> [1.0]               (1.0, 0.5 or 0.0 for white, draw and black)
+//   <epd> c9 "1-0";           (1-0, 1/2-1/2 or 0-1)
+//
+// EPD lines may leave out the move counters. The file is read a chunk at a
+// time, the lines of which are parsed in place by threads (all cores when
+// 0), and the positions kept in the order of the file
+//
+std::vector<PackedPosition> parse(const std::string &path, ParseStats *stats = nullptr, unsigned threads = 0);
+
+// Convert such a file into a dataset file, returns the number of positions
+size_t convert(const std::string &input, const std::string &output, ParseStats *stats = nullptr);
+
+}; // namespace dataset
+
+}; // namespace chess
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include "./hashtable.h"
+#include "./score.h"
+
+//
+// Caches the static evaluation of positions, keyed by their zobrist hash
+//
+// The same leaves get evaluated over and over through transpositions and
+// the frontier (futility, razoring, quiescence stand pat), and the weighted
+// sum is the most expensive part of a node. Entries hold white's score, so
+// a position is a hit no matter whose perspective is asked.
+//
+// Shared between the search threads like the transposition table (see
+// hashtable.h), and always replaced on store.
+//
+namespace chess {
+
+class EvalCache : public LocklessTable<EvalCache> {
+public:
+  struct Entry {
+    Score white = 0;
+  };
+
+  explicit EvalCache(size_t megabytes = 4) : LocklessTable(megabytes) {}
+
+private:
+  friend LocklessTable;
+
+  static uint64_t pack(Entry e) { return (uint32_t)e.white; }
+  static Entry unpack(uint64_t data) { return {(Score)(uint32_t)data}; }
+};
+
+}; // namespace chess
@@ -4,7 +4,9 @@
 #include "./pst.h"
 #include "./game.tcc"
 #include<string>
+#include <array>
 #include <utility>
+#include <type_traits>
 
 inline float randf(float max){
     return static_cast <float> (rand()) / (static_cast <float> (RAND_MAX) / max);
@@ -96,6 +98,17 @@ namespace chess::evaluators {
             this->knight = knight;
             this->pawn = pawn;
         }
+        float of(Game::PieceKind kind) const{
+            switch(kind){
+                case Game::PieceKind::King: return king;
+                case Game::PieceKind::Queen: return queen;
+                case Game::PieceKind::Rook: return rook;
+                case Game::PieceKind::Bishop: return bishop;
+                case Game::PieceKind::Knight: return knight;
+                case Game::PieceKind::Pawn: return pawn;
+            }
+            return 0;
+        }
         PerPiece operator*(float by) const{
             return {
                 king*by,
@@ -153,44 +166,77 @@ namespace chess::evaluators {
 
 using namespace chess;
 
+// Terms weighted per piece take any `Pieces` with the members of PerPiece,
+// so the compiled evaluator can hand them constexpr weights
+// (see agents/static_weights.h). They are computed in the type of the
+// weights, float for training and integers for the search
+template <class Pieces>
+using piece_weight_t = std::remove_cvref_t<decltype(std::declval<Pieces>().pawn)>;
+
+//
+// The attack maps of a position, computed once for both teams
+//
+// They are by far the most expensive part of the evaluation, and the
+// check, vulnerability, center control and covered pieces terms each
+// need them for one or both sides. Every term reads them from here,
+// so a node builds each map once instead of once per term and team.
+//
+// NOTE: Only valid for positions with a team to move
+//
+struct EvalContext {
+    const Game &game;
+    // Indexed by Game::Team
+    std::array<Bitboard, 2> occupancy;
+    std::array<Bitboard, 2> attacks;
+    std::array<Bitboard, 2> kings;
+    std::array<bool, 2> checked;
+
+    explicit EvalContext(const Game &game) : game(game) {
+        constexpr auto W = (int)Game::Team::White, B = (int)Game::Team::Black;
+        occupancy[W] = game.positions.whites;
+        occupancy[B] = game.positions.blacks;
+        attacks[W] = game.pseudo_attack_board<Game::Team::White>();
+        attacks[B] = game.pseudo_attack_board<Game::Team::Black>();
+        for(int t : {W, B}){
+            kings[t] = game.positions.kings & occupancy[t];
+            checked[t] = (bool)(attacks[t == W ? B : W] & kings[t]);
+        }
+    }
+
+    static Game::Team enemy(Game::Team team) {
+        return team == Game::Team::White ? Game::Team::Black : Game::Team::White;
+    }
+    const Bitboard &ours(Game::Team team) const { return occupancy[(int)team]; }
+    const Bitboard &attacked_by(Game::Team team) const { return attacks[(int)team]; }
+};
+
 // Encourage positions where the enemy is in check
 // discourage allowing yourself to fall into check
-inline float check(const Game &game, Game::Team team) {
-    const float res = team==Game::Team::White ? 1 : -1;
-    if(game.is_checked<Game::Team::White>()){
+inline int check(const EvalContext &ctx, Game::Team team) {
+    const int res = team==Game::Team::White ? 1 : -1;
+    if(ctx.checked[(int)Game::Team::White]){
         return -res;
     }
-    else if(game.is_checked<Game::Team::Black>()){
+    else if(ctx.checked[(int)Game::Team::Black]){
         return res;
     }
     else return 0;
 }
 
 // Encourage having lots of moves available
-inline float mobility(const Game &game, Game::Team team) {
+inline int mobility(const Game &game, Game::Team team) {
   return team == Game::Team::Black ? game.positions.blacks.count() : game.positions.whites.count();
 }
 
 // Discourage being under attack
 // pieces with higher weights influence the vulnerability
 // more greatly
-inline float vulnerability(const Game &game, Game::Team team, PerPiece weights) {
-    //
-    // FIXME: This function is temporarily disabled because its very expensive and takes up 50% of runtime
-    //
-    // return 0;
-  auto occ =
-      team == Game::Team::White ? game.positions.whites : game.positions.blacks;
-
-
-
-  // Find all pieces
-
-
-
+template <class Pieces>
+inline piece_weight_t<Pieces> vulnerability(const EvalContext &ctx, Game::Team team, const Pieces &weights) {
+  using Value = piece_weight_t<Pieces>;
+  const auto &game = ctx.game;
   // Determine the number of each piece under attack
-  auto attacked = team == Game::Team::Black ? game.pseudo_danger_board<Game::Team::Black>() : game.pseudo_danger_board<Game::Team::White>();
-    occ &= attacked;
+  auto occ = ctx.ours(team) & ctx.attacked_by(EvalContext::enemy(team));
 
   auto kings = game.positions.kings & occ;
   auto queens = game.positions.queens & occ;
@@ -201,12 +247,12 @@ inline float vulnerability(const Game &game, Game::Team team, PerPiece weights)
 
 
 
-  float kings_cnt = kings.count();
-  float queens_cnt = queens.count();
-  float knights_cnt = knights.count();
-  float bishops_cnt = bishops.count();
-  float rooks_cnt = rooks.count();
-  float pawns_cnt = pawns.count();
+  Value kings_cnt = kings.count();
+  Value queens_cnt = queens.count();
+  Value knights_cnt = knights.count();
+  Value bishops_cnt = bishops.count();
+  Value rooks_cnt = rooks.count();
+  Value pawns_cnt = pawns.count();
 
   // Return the weighted sum of these values
   return -(kings_cnt * weights.king +
@@ -271,108 +317,37 @@ inline float pawn_development(const Game &game, Game::Team team) {
 }
 
 // Award good piece positioning
-inline float positioning(const Game &game, Game::Team team, PerPiece weights) {
-
-  using namespace piece_square_tables;
-  const Bitboard occ =
-      team == Game::Team::White ? game.positions.whites : game.positions.blacks;
-
-  // Calculate position bitboards
-  auto pawns = occ & game.positions.pawns;
-  auto rooks = occ & game.positions.rooks;
-  auto bishops = occ & game.positions.bishops;
-  auto queens = occ & game.positions.queens;
-  auto knights = occ & game.positions.knights;
-  auto kings = occ & game.positions.kings;
-
-  // Keep track of cumulative scoring for each piece
-  float pawns_accum = 0;
-  float rooks_accum = 0;
-  float bishops_accum = 0;
-  float queens_accum = 0;
-  float knights_accum = 0;
-  float kings_accum = 0;
-
-  bool is_endgame = game.stage == Game::GameStage::Endgame;
-  bool is_black = team == Game::Team::Black;
-
-  // Macro to remove unnecessary repetition of the table lookup logic
-#define addscores(index, piecename)                                            \
-  if (is_endgame && is_black)                                                  \
-    piecename##s_accum += endgame::piecename##_table_black[index];             \
-  else if (is_endgame)                                                         \
-    piecename##s_accum += endgame::piecename##_table_white[index];             \
-  else if (is_black)                                                           \
-    piecename##s_accum += midgame::piecename##_table_black[index];             \
-  else                                                                         \
-    piecename##s_accum += midgame::piecename##_table_white[index];
-
-  // 1: Pawn scoring
-  while (pawns.count()) {
-    auto bit = pawns.trailing_zeroes();
-    pawns ^= 1ULL << bit;
-    addscores(bit, pawn);
-  }
-
-  // 2: Rook scoring
-  while (rooks.count()) {
-    auto bit = rooks.trailing_zeroes();
-    rooks ^= 1ULL << bit;
-    addscores(bit, rook);
-  }
-  // 3: Bishop scoring
-  while (bishops.count()) {
-    auto bit = bishops.trailing_zeroes();
-    bishops ^= 1ULL << bit;
-    addscores(bit, bishop);
-  }
-  // 4: Knight Scoring
-  while (knights.count()) {
-    auto bit = knights.trailing_zeroes();
-    knights ^= 1ULL << bit;
-    addscores(bit, knight);
-  }
-  // 5: King Scoring
-  while (kings.count()) {
-    auto bit = kings.trailing_zeroes();
-    kings ^= 1ULL << bit;
-    addscores(bit, king);
-  }
-  // 6: Queen Scoring
-  while (queens.count()) {
-    auto bit = queens.trailing_zeroes();
-    queens ^= 1ULL << bit;
-    addscores(bit, queen);
-  }
-  return pawns_accum * weights.pawn +
-         kings_accum * weights.king+
-         queens_accum * weights.queen +
-         rooks_accum * weights.rook +
-         bishops_accum * weights.bishop +
-         knights_accum * weights.knight;
+// The table sums are kept by the game itself, see Game::Accumulators
+template <class Pieces>
+inline piece_weight_t<Pieces> positioning(const Game &game, Game::Team team, const Pieces &weights) {
+  const auto &acc = game.accumulators;
+  const auto &sums = game.stage == Game::GameStage::Endgame
+                         ? acc.endgame_pst[(int)team]
+                         : acc.midgame_pst[(int)team];
+
+#define sum(kind) sums[(int)Game::PieceKind::kind]
+  return sum(Pawn) * weights.pawn +
+         sum(King) * weights.king +
+         sum(Queen) * weights.queen +
+         sum(Rook) * weights.rook +
+         sum(Bishop) * weights.bishop +
+         sum(Knight) * weights.knight;
+#undef sum
 }
 
-inline float material_value(const Game &game, Game::Team team, PerPiece weights) {
-  const auto occ =
-      team == Game::Team::White ? game.positions.whites : game.positions.blacks;
-
-  float queen_val =
-      (occ & game.positions.queens).count() * weights.queen;
-  float bishop_val =
-      (occ & game.positions.bishops).count() * weights.bishop;
-  float rook_val =
-      (occ & game.positions.rooks).count() * weights.rook;
-  float knight_val =
-      (occ & game.positions.knights).count() * weights.knight;
-
-  float pawn_val =
-      (occ & game.positions.pawns).count() * weights.pawn;
-
-  return queen_val + bishop_val + rook_val + knight_val + pawn_val;
+template <class Pieces>
+inline piece_weight_t<Pieces> material_value(const Game &game, Game::Team team, const Pieces &weights) {
+  const auto &acc = game.accumulators;
+  return acc.count(team, Game::PieceKind::Queen) * weights.queen +
+         acc.count(team, Game::PieceKind::Bishop) * weights.bishop +
+         acc.count(team, Game::PieceKind::Rook) * weights.rook +
+         acc.count(team, Game::PieceKind::Knight) * weights.knight +
+         acc.count(team, Game::PieceKind::Pawn) * weights.pawn;
 }
 
 // Award having more material than the other team
-inline float material_advantage(const Game &game, Game::Team team, PerPiece weights) {
+template <class Pieces>
+inline piece_weight_t<Pieces> material_advantage(const Game &game, Game::Team team, const Pieces &weights) {
   if (team == Game::Team::White)
     return material_value(game, Game::Team::White, weights) -
            material_value(game, Game::Team::Black, weights);
@@ -421,13 +396,79 @@ inline float king_front_pawns(const Game& game, Game::Team team){
         return (white_king_front_pawns[king_bit.trailing_zeroes()] & game.positions.whites & game.positions.pawns).count();
     }
     else{
-        auto king_bit = game.positions.kings & game.positions.whites;
+        auto king_bit = game.positions.kings & game.positions.blacks;
         return (black_king_front_pawns[king_bit.trailing_zeroes()] & game.positions.blacks & game.positions.pawns).count();
 
     }
 }
 
-const std::vector<float> center_ctrl_scores = {
+//
+// Pawn structure
+// https://www.chessprogramming.org/Pawn_Structure
+//
+static constexpr std::array<uint64_t, 8> pawn_files = []() constexpr{
+    std::array<uint64_t, 8> arr{};
+    for(int col = 0; col < 8; col++)
+        arr[col] = 0x0101010101010101ULL << col;
+    return arr;
+}();
+static constexpr std::array<uint64_t, 8> adjacent_pawn_files = []() constexpr{
+    std::array<uint64_t, 8> arr{};
+    for(int col = 0; col < 8; col++)
+        arr[col] = (col ? pawn_files[col - 1] : 0) | (col != 7 ? pawn_files[col + 1] : 0);
+    return arr;
+}();
+// Squares in front of a pawn on its own and the adjacent files,
+// indexed by [team][square]
+static constexpr std::array<std::array<uint64_t, 64>, 2> pawn_front_span = []() constexpr{
+    std::array<std::array<uint64_t, 64>, 2> arr{};
+    for(int i = 0; i < 64; i++){
+        auto row = i / 8, col = i % 8;
+        auto files = pawn_files[col] | adjacent_pawn_files[col];
+        uint64_t above = row == 7 ? 0 : ~0ULL << (8 * (row + 1));
+        uint64_t below = row == 0 ? 0 : ~0ULL >> (8 * (8 - row));
+        arr[(int)Game::Team::White][i] = files & above;
+        arr[(int)Game::Team::Black][i] = files & below;
+    }
+    return arr;
+}();
+
+// Number of pawns which no enemy pawn can stop from promoting
+inline float passed_pawns(const Game &game, Game::Team team){
+    auto ours = game.positions.pawns & (team == Game::Team::White ? game.positions.whites : game.positions.blacks);
+    auto theirs = game.positions.pawns & (team == Game::Team::White ? game.positions.blacks : game.positions.whites);
+    float passed = 0;
+    FOR_BIT(ours, {
+        if(!(Bitboard(pawn_front_span[(int)team][bit.trailing_zeroes()]) & theirs))
+            passed++;
+    });
+    return passed;
+}
+
+// Number of pawns without a friendly pawn on the adjacent files
+inline float isolated_pawns(const Game &game, Game::Team team){
+    auto ours = game.positions.pawns & (team == Game::Team::White ? game.positions.whites : game.positions.blacks);
+    float isolated = 0;
+    FOR_BIT(ours, {
+        if(!(Bitboard(adjacent_pawn_files[bit.trailing_zeroes() % 8]) & ours))
+            isolated++;
+    });
+    return isolated;
+}
+
+// Number of pawns stacked behind another pawn of the same team
+inline float doubled_pawns(const Game &game, Game::Team team){
+    auto ours = game.positions.pawns & (team == Game::Team::White ? game.positions.whites : game.positions.blacks);
+    float doubled = 0;
+    for(auto file : pawn_files){
+        auto count = (ours & Bitboard(file)).count();
+        if(count > 1)
+            doubled += count - 1;
+    }
+    return doubled;
+}
+
+const std::vector<int> center_ctrl_scores = {
         0, 0, 0,  0, 0,  0, 0, 0,
         0, 0, 0,  2, 2,  0, 0, 0,
         0, 0, 2,  6, 6,  2, 0, 0,
@@ -438,34 +479,22 @@ const std::vector<float> center_ctrl_scores = {
         0, 0, 0,  0, 0,  0, 0, 0,
 };
 // Number of center squares
-inline float center_control(const Game &game, Game::Team team) {
+inline int center_control(const EvalContext &ctx, Game::Team team) {
     // A square is controlled if it is either occupied or exclusively attacked
-    if(team == Game::Team::White){
-        float total_score = 0;
-        auto exclusive_attacks = game.pseudo_attack_board<Game::Team::White>() & ~game.pseudo_attack_board<Game::Team::Black>();
-        auto occupation = game.positions.whites;
-        auto controlled_squares = occupation | exclusive_attacks;
-
-        FOR_BIT(controlled_squares, {
-            total_score += center_ctrl_scores[bit.trailing_zeroes()];
-        });
-        return total_score;
-    }
-    else{
-        float total_score = 0;
-        auto exclusive_attacks = game.pseudo_attack_board<Game::Team::Black>() & ~game.pseudo_attack_board<Game::Team::White>();
-        auto occupation = game.positions.blacks;
-        auto controlled_squares = occupation | exclusive_attacks;
-
-        FOR_BIT(controlled_squares, {
-            total_score += center_ctrl_scores[bit.trailing_zeroes()];
-        });
-        return total_score;
-    }
+    int total_score = 0;
+    auto exclusive_attacks = ctx.attacked_by(team) & ~ctx.attacked_by(EvalContext::enemy(team));
+    auto controlled_squares = ctx.ours(team) | exclusive_attacks;
+
+    FOR_BIT(controlled_squares, {
+        total_score += center_ctrl_scores[bit.trailing_zeroes()];
+    });
+    return total_score;
 }
 
-inline float covered_pieces(const Game& game, Game::Team team, PerPiece weights){
-    auto covered = team == Game::Team::White ? game.positions.whites & game.pseudo_attack_board<Game::Team::White>() : game.positions.blacks & game.pseudo_attack_board<Game::Team::Black>();
+template <class Pieces>
+inline int covered_pieces(const EvalContext &ctx, Game::Team team, const Pieces &weights){
+    const auto &game = ctx.game;
+    auto covered = ctx.ours(team) & ctx.attacked_by(team);
     int sum = 0;
     sum += (covered & game.positions.kings).count() * weights.king;
     sum += (covered & game.positions.queens).count() * weights.queen;
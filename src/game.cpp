@@ -3,6 +3,8 @@
 #include "./agent.h"
 #include "zobrist.h"
 #include "evaluate.h"
+#include "pst.h"
+#include<charconv>
 #include<iostream>
 using namespace chess;
 #define FOR_BIT(board, exec)                                                   \
@@ -59,13 +61,14 @@ void Game::remove_piece(Piece piece) {
 
     // Remove from piece board
 #define ZOB(piecekind) \
-    if(piece.team == Team::White)zobrist_hash ^= zobrist:: white_##piecekind [piece.position.trailing_zeroes()]; \
-    else zobrist_hash ^= zobrist:: black_##piecekind [piece.position.trailing_zeroes()];
+    if(piece.team == Team::White)zobrist_hash ^= zobrist:: white_##piecekind [zobrist::square_of(piece.position)]; \
+    else zobrist_hash ^= zobrist:: black_##piecekind [zobrist::square_of(piece.position)];
 
     switch (piece.kind) {
         case PieceKind::Pawn:
             positions.pawns ^= piece.position;
             ZOB(pawns)
+            pawn_hash ^= zobrist::pawn_key(piece.position, piece.team == Team::White, false);
             break;
         case PieceKind::Rook:
             positions.rooks ^= piece.position;
@@ -102,9 +105,11 @@ void Game::remove_piece(Piece piece) {
         case PieceKind::King:
             positions.kings ^= piece.position;
             ZOB(kings)
+            pawn_hash ^= zobrist::pawn_key(piece.position, piece.team == Team::White, true);
             break;
     }
 #undef ZOB
+    accumulate(piece.position, piece.kind, piece.team, false);
     // We have to recalculate all of the cached pieces
     // because many moves are dependant on other pieces
     // positioning (i.e rooks)
@@ -117,13 +122,14 @@ void Game::add_piece(Bitboard pos, PieceKind kind, Team team) {
     else
         positions.whites |= pos;
 #define ZOB(piecekind) \
-    if(team == Team::White)zobrist_hash ^= zobrist:: white_##piecekind [pos.trailing_zeroes()]; \
-    else zobrist_hash ^= zobrist:: black_##piecekind [pos.trailing_zeroes()];
+    if(team == Team::White)zobrist_hash ^= zobrist:: white_##piecekind [zobrist::square_of(pos)]; \
+    else zobrist_hash ^= zobrist:: black_##piecekind [zobrist::square_of(pos)];
 
     switch (kind) {
         case PieceKind::King:
             positions.kings |= pos;
             ZOB(kings)
+            pawn_hash ^= zobrist::pawn_key(pos, team == Team::White, true);
             break;
         case PieceKind::Queen:
             positions.queens |= pos;
@@ -143,9 +149,45 @@ void Game::add_piece(Bitboard pos, PieceKind kind, Team team) {
             break;
         case PieceKind::Pawn:
             ZOB(pawns)
+            pawn_hash ^= zobrist::pawn_key(pos, team == Team::White, false);
             positions.pawns |= pos;
             break;
     }
+#undef ZOB
+    accumulate(pos, kind, team, true);
+}
+
+void Game::accumulate(Bitboard pos, PieceKind kind, Team team, bool added) {
+    using namespace piece_square_tables;
+    static constexpr int32_t PHASE[6] = {0, 1, 2, 1, 4, 0};
+    auto sign = added ? 1 : -1;
+    auto square = pos.trailing_zeroes();
+    auto t = (int) team, k = (int) kind;
+
+    accumulators.counts[t][k] += sign;
+    accumulators.midgame_pst[t][k] += sign * scoring_table(team, kind, GameStage::MidGame)[square];
+    accumulators.endgame_pst[t][k] += sign * scoring_table(team, kind, GameStage::Endgame)[square];
+    accumulators.phase += sign * PHASE[k];
+    deltas.push({(uint8_t) square, kind, team, added});
+}
+
+void Game::generate_accumulators() {
+    accumulators = {};
+    auto add = [&](Bitboard board, PieceKind kind) {
+        while (board) {
+            Bitboard bit = 1ULL << board.popbit();
+            accumulate(bit, kind, bit & positions.whites ? Team::White : Team::Black, true);
+        }
+    };
+    add(positions.pawns, PieceKind::Pawn);
+    add(positions.bishops, PieceKind::Bishop);
+    add(positions.rooks, PieceKind::Rook);
+    add(positions.knights, PieceKind::Knight);
+    add(positions.queens, PieceKind::Queen);
+    add(positions.kings, PieceKind::King);
+    // Nothing to replay, whoever reads the log has to start from scratch
+    deltas.clear();
+    deltas.overflowed = true;
 }
 
 
@@ -228,7 +270,7 @@ void Game::pretty_print(Bitboard highlight) const {
     std::cout << std::endl;
 }
 
-std::vector <Game::Move> Game::movelist(Team team) const {
+std::vector <Game::Move> Game::movelist(Team team, bool tactical_only) const {
     auto bb = team == Team::Black ? positions.blacks : positions.whites;
     auto enemybb = team == Team::Black ? positions.whites : positions.blacks;
 
@@ -243,7 +285,12 @@ std::vector <Game::Move> Game::movelist(Team team) const {
     FOR_BIT(bb, {
         auto piece_pos = bit;
         auto piece = fetch_piece(piece_pos);
-        FOR_BIT(piece->pseudolegal_moves, {
+        auto targets = piece->pseudolegal_moves;
+        if (tactical_only) {
+            targets &= piece->kind == PieceKind::Pawn ? enemybb | enpassant | Bitboard::Row1 | Bitboard::Row8
+                                                      : enemybb;
+        }
+        FOR_BIT(targets, {
 
                 Game::Move m;
                 m.piece = piece;
@@ -260,6 +307,11 @@ std::vector <Game::Move> Game::movelist(Team team) const {
                         } else if (bit & enpassant) {
                             m.kind = Game::Move::Enpassant;
                         } else if (bit & (Bitboard::Row1 | Bitboard::Row8)) {
+                            m.kind = Game::Move::PromoteQueen;
+                            if (tactical_only) {
+                                capturing_moves.push_back(m);
+                                continue;
+                            }
                             m.kind = Game::Move::PromoteBishop;
                             moves.push_back(m);
                             m.kind = Game::Move::PromoteKnight;
@@ -280,14 +332,11 @@ std::vector <Game::Move> Game::movelist(Team team) const {
                 }
         });
 
-        if (piece->kind == PieceKind::King) {
-            auto defense = piece->team == Team::Black ? this->danger_board<Game::Team::Black>() : danger_board<Game::Team::White>();
+        if (piece->kind == PieceKind::King && !tactical_only) {
             auto can_kingside = can_castle_kingside(
-                    piece->team, positions.blacks | positions.whites, defense,
-                    piece->team == Team::Black ? castle.bks : castle.wks);
+                    *this, piece->team, piece->team == Team::Black ? castle.bks : castle.wks);
             auto can_queenside = can_castle_queenside(
-                    piece->team, positions.blacks | positions.whites, defense,
-                    piece->team == Team::Black ? castle.bqs : castle.wqs);
+                    *this, piece->team, piece->team == Team::Black ? castle.bqs : castle.wqs);
 
             Bitboard row =
                     piece->team == Team::White ? Bitboard::Row1 : Bitboard::Row8;
@@ -410,7 +459,7 @@ std::string Game::simple_fen() const {
 //
 // Create a new game with an FEN string
 //
-Game Game::create(std::string fen_str) {
+Game Game::create(std::string_view fen_str) {
     uint8_t row = 7;
     uint8_t col = 0;
 
@@ -459,18 +508,27 @@ Game Game::create(std::string fen_str) {
     }
     after:
 
-    auto active_color = fen_str[idx + 1];
-    if (active_color != 'w' && active_color != 'b')
+    // The remaining fields, separated by spaces
+    auto rest = fen_str.substr(idx);
+    auto next_field = [&]() {
+        while (!rest.empty() && rest.front() == ' ')
+            rest.remove_prefix(1);
+        auto field = rest.substr(0, rest.find(' '));
+        rest.remove_prefix(field.size());
+        return field;
+    };
+
+    auto active_color = next_field();
+    if (active_color != "w" && active_color != "b")
         throw chess::Error("Unrecognized team color");
-    game.state = active_color == 'w' ? State::WhiteToMove : State::BlackToMove;
+    game.state = active_color == "w" ? State::WhiteToMove : State::BlackToMove;
 
     //
     // Parse castle status
     //
-    auto castle_status = fen_str.substr(idx + 3, idx + 8);
-    auto end_idx = castle_status.find(' ');
-    idx += 3 + end_idx + 1;
-    castle_status = castle_status.substr(0, end_idx);
+    auto castle_status = next_field();
+    // Only the listed rights remain
+    game.castle.wks = game.castle.wqs = game.castle.bks = game.castle.bqs = false;
     if (castle_status != "-") {
         for (auto c: castle_status) {
             switch (c) {
@@ -489,29 +547,51 @@ Game Game::create(std::string fen_str) {
             }
         }
     }
-    auto enpassant = fen_str.substr(idx);
 
     //
     // parse enpassant status
     //
-    if (enpassant[0] != '-') {
-        uint8_t col = enpassant[1] - 'a';
-        uint8_t row = enpassant[2] - '0';
+    auto enpassant = next_field();
+    if (enpassant.size() == 2) {
+        uint8_t col = enpassant[0] - 'a';
+        uint8_t row = enpassant[1] - '1';
+        if (col > 7 || row > 7)
+            throw chess::Error("Unrecognized enpassant square");
         game.enpassant = (1ULL << col) << (row * 8);
-        idx += 5;
-
-    } else
-        idx += 2;
+    } else if (enpassant != "-")
+        throw chess::Error("Unrecognized enpassant square");
+
+    // EPD leaves out the move counters
+    auto counter = [&](uint32_t missing) {
+        auto field = next_field();
+        if (field.empty())
+            return missing;
+        uint32_t value;
+        auto [end, err] = std::from_chars(field.data(), field.data() + field.size(), value);
+        if (err != std::errc() || end != field.data() + field.size())
+            throw chess::Error("Unrecognized move counter");
+        return value;
+    };
+    game.halfmoves = counter(0);
+    game.fullmoves = counter(1);
+    return create(game.positions, game.current_active_team(), game.castle, game.enpassant, game.halfmoves,
+                  game.fullmoves);
+}
 
-    auto halfmove = fen_str.substr(idx);
-    auto halfmove_endidx = halfmove.find(' ');
-    halfmove = halfmove.substr(0, halfmove_endidx);
-    game.halfmoves = std::stoul(halfmove);
-    idx += halfmove_endidx + 1;
+Game Game::create(const PositionalInfo &positions, Team to_move, CastleInfo castle, Bitboard enpassant,
+                  uint32_t halfmoves, uint32_t fullmoves) {
+    Game game;
+    game.positions = positions;
+    game.state = to_move == Team::White ? State::WhiteToMove : State::BlackToMove;
+    game.castle = castle;
+    game.enpassant = enpassant;
+    game.halfmoves = halfmoves;
+    game.fullmoves = fullmoves;
 
-    auto fullmove = fen_str.substr(idx);
-    game.fullmoves = std::stoul(fullmove);
-    // game.generate_zobrist_hash();
+    // The transposition table is keyed by this hash, so it has to describe
+    // the actual position rather than the delta from the starting one
+    game.generate_zobrist_hash();
+    game.generate_accumulators();
 
 
     // Material count < 40 -> A Capture must have happened
@@ -667,6 +747,8 @@ uint8_t Game::make_move(Move m) {
             zobrist_hash ^= zobrist::black_rooks[ROOK_NEW_POS.trailing_zeroes()];
         }
         positions.rooks ^= REPOSITION_MAP;
+        accumulate(ROOK_INITIAL_POS, PieceKind::Rook, piece.team, false);
+        accumulate(ROOK_NEW_POS, PieceKind::Rook, piece.team, true);
 
     }
     // When capturing via enpassant
@@ -679,12 +761,14 @@ uint8_t Game::make_move(Move m) {
         // Apply the kill board
         if (piece.team == Team::White) {
             positions.blacks ^= KILL_BOARD;
-            zobrist_hash ^= zobrist::white_pawns[KILL_BOARD.trailing_zeroes()];
+            zobrist_hash ^= zobrist::black_pawns[KILL_BOARD.trailing_zeroes()];
         } else {
             positions.whites ^= KILL_BOARD;
-            zobrist_hash ^= zobrist::black_pawns[KILL_BOARD.trailing_zeroes()];
+            zobrist_hash ^= zobrist::white_pawns[KILL_BOARD.trailing_zeroes()];
         }
         positions.pawns ^= KILL_BOARD;
+        pawn_hash ^= zobrist::pawn_key(KILL_BOARD, piece.team != Team::White, false);
+        accumulate(KILL_BOARD, PieceKind::Pawn, piece.team == Team::White ? Team::Black : Team::White, false);
     }
 
     if (stage == GameStage::Opening) {
@@ -695,7 +779,7 @@ uint8_t Game::make_move(Move m) {
         }
     } else if (stage == GameStage::MidGame) {
         // Endgame occurs when either team has 3 pieces or less
-        if (positions.whites.count() <= 3 || positions.blacks.count() <= 3) {
+        if (accumulators.pieces(Team::White) <= 3 || accumulators.pieces(Team::Black) <= 3) {
             stage = GameStage::Endgame;
         }
     }
@@ -779,6 +863,45 @@ uint8_t Game::make_move(Move m) {
 }
 
 
+void Game::make_null_move() {
+    // The enpassant square is only valid for the move right after the doublejump
+    zobrist_hash ^= enpassant_hash(enpassant);
+    enpassant = 0;
+
+    zobrist_hash ^= zobrist::black_to_move;
+    state = state == State::WhiteToMove ? State::BlackToMove : State::WhiteToMove;
+    cached_pieces = 0;
+}
+
+
+std::optional<Game::Move> Game::find_move(uint16_t packed) const {
+    if (state != State::WhiteToMove && state != State::BlackToMove)
+        return std::nullopt;
+    for (auto &m: movelist(current_active_team())) {
+        if (m.packed() == packed)
+            return m;
+    }
+    return std::nullopt;
+}
+
+std::string Game::Move::packed_str(uint16_t packed) {
+    Bitboard source = 1ULL << (packed & 63);
+    Bitboard target = 1ULL << ((packed >> 6) & 63);
+    auto str = source.standard_notation() + target.standard_notation();
+    switch ((MoveType) (packed >> 12)) {
+        case PromoteQueen:
+            return str + "q";
+        case PromoteRook:
+            return str + "r";
+        case PromoteBishop:
+            return str + "b";
+        case PromoteKnight:
+            return str + "n";
+        default:
+            return str;
+    }
+}
+
 Game::Move Game::get_agent_move(const Agent &ag) const {
     auto move = ag.move(*this);
     return move;
@@ -788,7 +911,7 @@ inline float fast_sigmoid(float x){
     return x / ( 1 + (x < 0 ? -x : x) );
 }
 
-float Game::advantage(Game::Team team, agents::Weighted eval) const {
+float Game::advantage(Game::Team team, const agents::Weighted &eval) const {
     auto my_eval = evaluate(team, eval);
     auto enemy_eval = evaluate(team == Game::Team::White ? Game::Team::Black : Game::Team::White, eval);
 
@@ -812,7 +935,7 @@ float Game::advantage(Game::Team team, agents::Weighted eval) const {
 //
 // (weighted sum)
 //
-float Game::evaluate(Team team, agents::Weighted eval) const {
+float Game::evaluate(Team team, const agents::Weighted &eval) const {
     // TODO: Create a default instance of the weighted evaluator
     //       to generate the evaluation scores
     auto ws = eval.weightedsum(*this, team);
@@ -844,47 +967,23 @@ float Game::evaluate(Team team, agents::Weighted eval) const {
 void Game::generate_zobrist_hash() {
     zobrist::Hash hash = 0;
 
-    FOR_BIT(positions.pawns & positions.whites, {
-        hash ^= zobrist::white_pawns[bit.trailing_zeroes()];
-    });
-    FOR_BIT(positions.pawns & positions.blacks, {
-        hash ^= zobrist::black_pawns[bit.trailing_zeroes()];
-    });
-
-    FOR_BIT(positions.rooks & positions.whites, {
-        hash ^= zobrist::white_rooks[bit.trailing_zeroes()];
-    });
-    FOR_BIT(positions.rooks & positions.blacks, {
-        hash ^= zobrist::black_rooks[bit.trailing_zeroes()];
-    });
-
-    FOR_BIT(positions.bishops & positions.whites, {
-        hash ^= zobrist::white_bishops[bit.trailing_zeroes()];
-    });
-    FOR_BIT(positions.bishops & positions.blacks, {
-        hash ^= zobrist::black_bishops[bit.trailing_zeroes()];
-    });
-
-    FOR_BIT(positions.knights & positions.whites, {
-        hash ^= zobrist::white_knights[bit.trailing_zeroes()];
-    });
-    FOR_BIT(positions.knights & positions.blacks, {
-        hash ^= zobrist::black_knights[bit.trailing_zeroes()];
-    });
-
-    FOR_BIT(positions.queens & positions.whites, {
-        hash ^= zobrist::white_queens[bit.trailing_zeroes()];
-    });
-    FOR_BIT(positions.queens & positions.blacks, {
-        hash ^= zobrist::black_queens[bit.trailing_zeroes()];
-    });
-
-    FOR_BIT(positions.kings & positions.whites, {
-        hash ^= zobrist::white_kings[bit.trailing_zeroes()];
-    });
-    FOR_BIT(positions.kings & positions.blacks, {
-        hash ^= zobrist::black_kings[bit.trailing_zeroes()];
-    });
+    // Only visits the occupied squares (FOR_BIT tries all 64)
+    auto add = [&](Bitboard board, const auto &keys) {
+        while (board)
+            hash ^= keys[board.popbit()];
+    };
+    add(positions.pawns & positions.whites, zobrist::white_pawns);
+    add(positions.pawns & positions.blacks, zobrist::black_pawns);
+    add(positions.rooks & positions.whites, zobrist::white_rooks);
+    add(positions.rooks & positions.blacks, zobrist::black_rooks);
+    add(positions.bishops & positions.whites, zobrist::white_bishops);
+    add(positions.bishops & positions.blacks, zobrist::black_bishops);
+    add(positions.knights & positions.whites, zobrist::white_knights);
+    add(positions.knights & positions.blacks, zobrist::black_knights);
+    add(positions.queens & positions.whites, zobrist::white_queens);
+    add(positions.queens & positions.blacks, zobrist::black_queens);
+    add(positions.kings & positions.whites, zobrist::white_kings);
+    add(positions.kings & positions.blacks, zobrist::black_kings);
 
     if (castle.bks)hash ^= zobrist::black_kingside;
     if (castle.bqs)hash ^= zobrist::black_queenside;
@@ -897,6 +996,14 @@ void Game::generate_zobrist_hash() {
 
 
     this->zobrist_hash = hash;
+
+    zobrist::Hash pawns = 0;
+    auto pawns_and_kings = positions.pawns | positions.kings;
+    while (pawns_and_kings) {
+        Bitboard bit = 1ULL << pawns_and_kings.popbit();
+        pawns ^= zobrist::pawn_key(bit, (bool) (bit & positions.whites), (bool) (bit & positions.kings));
+    }
+    this->pawn_hash = pawns;
 }
 
 
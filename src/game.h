@@ -3,6 +3,8 @@
 #include "bitboard.h"
 #include <array>
 #include <vector>
+#include <optional>
+#include <string_view>
 #include<map>
 #include<iostream>
 
@@ -14,12 +16,10 @@ namespace chess {
 }
 class Agent;
 class Game {
-    static inline bool magicmoves_initialized = false;
-
   Game() {
-    if (!magicmoves_initialized)
-      initmagicmoves();
-    magicmoves_initialized = true;
+    // Once, even when the first games are created on several threads
+    static const bool magicmoves_initialized = (initmagicmoves(), true);
+    (void)magicmoves_initialized;
   }
 
 public:
@@ -62,7 +62,7 @@ public:
       return "Pawn";
     }
   }
-  static Game create(std::string fen_str);
+  static Game create(std::string_view fen_str);
 
   struct PositionalInfo {
     Bitboard kings;
@@ -103,6 +103,11 @@ public:
   } state = State::WhiteToMove;
 
   enum GameStage { Opening, MidGame, Endgame } stage = GameStage::Opening;
+
+  // The same as create, from the fields of a FEN parsed already
+  // (see dataset.h), everything else is derived from them
+  static Game create(const PositionalInfo &positions, Team to_move, CastleInfo castle,
+                     Bitboard enpassant, uint32_t halfmoves, uint32_t fullmoves);
   // A way to store info about a given piece
   // NOTE:
   // Only valid until the next move due to the unpredictable
@@ -138,6 +143,17 @@ public:
 
     } kind;
 
+    // Compact 16-bit encoding of the move (source, target, kind)
+    // unlike the piece pointer, this stays valid across copies of the game
+    // so it can be stored in search tables
+    uint16_t packed() const {
+      return source_pos.trailing_zeroes() | (target_pos.trailing_zeroes() << 6) |
+             ((uint16_t)kind << 12);
+    }
+
+    // Long algebraic notation of a packed move (e2e4, e7e8q)
+    static std::string packed_str(uint16_t packed);
+
     std::string str() const {
       std::string str = "Moving A " + team_str(piece->team) + " " +
                         kind_str(piece->kind) + " from " +
@@ -159,6 +175,10 @@ public:
 
   uint8_t make_move(Move m);
 
+  // Pass the turn to the other team without moving
+  // (only used by the search, this is not a legal chess move)
+  void make_null_move();
+
   template<Game::Team TEAM>
   [[nodiscard]] bool is_mated() const;
 
@@ -167,6 +187,10 @@ public:
   template<Game::Team TEAM>
   bool is_checked() const;
 
+  // Find the legal move matching a packed move (see Move::packed)
+  // for the current team
+  std::optional<Move> find_move(uint16_t packed) const;
+
   std::string simple_fen() const;
 
   // Show all positions where a piece of the
@@ -181,6 +205,16 @@ public:
   template<Game::Team TEAM>
   Bitboard attack_board() const;
 
+  // Every piece (of either team) attacking square, were the pieces on the
+  // board the ones in occupied. Looks outward from the square with the
+  // knight, king, pawn and magic slider tables instead of generating the
+  // moves of every piece, so "is this square attacked" only takes a
+  // handful of lookups
+  Bitboard attackers_to(Bitboard square, Bitboard occupied) const;
+
+  // Whether the enemies of team attack any of the squares
+  bool is_attacked(Team team, Bitboard squares) const;
+
   // Similar to checking for a non-empty attack_board
   // but much faster
   template<Game::Team TEAM>
@@ -201,7 +235,9 @@ public:
   template<Game::Team TEAM>
   Bitboard attack_board_incl_castles() const;
 
-  std::vector<Move> movelist(Team team) const;
+  // When tactical_only is set, only captures, en passant and queen
+  // promotions are generated (used by the quiescence search)
+  std::vector<Move> movelist(Team team, bool tactical_only = false) const;
 
   void pretty_print(Bitboard highlight = 0) const;
 
@@ -225,24 +261,87 @@ public:
 
   uint64_t zobrist_hash = 0;
 
+  // Zobrist hash of the pawns and kings only, keys the pawn
+  // structure cache (see pawns.h)
+  uint64_t pawn_hash = 0;
+
   // This should only be called on initialization
-  // The zobrist hash is incrementally updated from
+  // The zobrist hashes are incrementally updated from
   // then-on
   void generate_zobrist_hash();
 
-  struct TranspositionTableEntry{
-      float evaluation;
-      uint32_t depth;
+  ///////////////////////////////////
+  //// EVALUATION ACCUMULATORS //////
+  ///////////////////////////////////
+
+  //
+  // Material and piece-square table terms are additive, so just like the
+  // zobrist hash they are kept up to date by add_piece and remove_piece
+  // (and the moves which edit the boards directly) instead of having the
+  // evaluator rescan the board at every leaf
+  //
+  struct Accumulators {
+    // Number of pieces, indexed by [team][kind]
+    std::array<std::array<uint8_t, 6>, 2> counts{};
+    // Unweighted piece-square table sums, indexed by [team][kind]
+    std::array<std::array<int32_t, 6>, 2> midgame_pst{};
+    std::array<std::array<int32_t, 6>, 2> endgame_pst{};
+    // Non-pawn material on the board, from 24 (every piece) down to 0
+    // minor pieces count 1, rooks 2 and queens 4
+    int32_t phase = 0;
+
+    uint8_t count(Team team, PieceKind kind) const {
+      return counts[(int)team][(int)kind];
+    }
+    uint8_t pieces(Team team) const {
+      uint8_t total = 0;
+      for (auto c : counts[(int)team])
+        total += c;
+      return total;
+    }
 
-      enum NodeType{
-          Exact,
-          Upperbound, // Fail High
-          Lowerbound, // Fail Low
-      } type;
+    bool operator==(const Accumulators &o) const = default;
+  } accumulators;
 
+  //
+  // The pieces added and removed since the log was last cleared, for
+  // evaluators that keep accumulators of their own (see nnue.h).
+  // A move touches at most four squares (castling), when more changes
+  // than that pile up the log only remembers that it overflowed
+  //
+  struct PieceDelta {
+    uint8_t square;
+    PieceKind kind;
+    Team team;
+    bool added;
   };
+  struct PieceDeltas {
+    static constexpr int CAPACITY = 8;
+    std::array<PieceDelta, CAPACITY> items;
+    uint8_t count = 0;
+    bool overflowed = false;
+
+    void clear() {
+      count = 0;
+      overflowed = false;
+    }
+    void push(PieceDelta delta) {
+      if (count == CAPACITY)
+        overflowed = true;
+      else
+        items[count++] = delta;
+    }
+  } deltas;
 
-  static std::map<uint64_t, TranspositionTableEntry> transposition_table;
+  // Like generate_zobrist_hash, only needed on initialization
+  void generate_accumulators();
+
+  // Account for a piece appearing on (or disappearing from) pos
+  void accumulate(Bitboard pos, PieceKind kind, Team team, bool added);
+
+  // NOTE:
+  // The transposition table itself lives with the searching agent
+  // (see transposition.h), so that concurrent searches may share it
 
     Move get_agent_move(const Agent& ag) const;
 
@@ -257,8 +356,8 @@ public:
   // from guesswork, no hard data involved
 
 
-  float evaluate(Team, agents::Weighted) const;
-  float advantage(Team, agents::Weighted) const;
+  float evaluate(Team, const agents::Weighted &) const;
+  float advantage(Team, const agents::Weighted &) const;
 
   ///////////////////////////////////
   //// Engine-Related Functions /////
@@ -35,66 +35,51 @@ Bitboard pseudo_attack_board_internal(const Game &game, bool utilizecache)
     Bitboard all_attacks;
     auto team = game.current_active_team();
 
+    // Only visits the occupied squares (FOR_BIT tries all 64), this is
+    // the hot loop of the evaluation
     if(team == Game::Team::White){
-    FOR_BIT(board, {
-        auto pos = bit;
-        // auto piece = utilizecache ? *game.fetch_piece<TEAM>(bit)
-        //                           : internal::fetch_piece_nocache<TEAM>(game, bit);
-        auto piece = internal::fetch_piece_nocache<Game::Team::White>(game, bit);
-        auto moves = piece.pseudolegal_moves;
-
-        all_attacks |= moves;
-    });
+    while (board) {
+        Bitboard bit = 1ULL << board.popbit();
+        all_attacks |= internal::fetch_piece_nocache<Game::Team::White>(game, bit).pseudolegal_moves;
+    }
     }
     else{
-    FOR_BIT(board, {
-        auto pos = bit;
-        // auto piece = utilizecache ? *game.fetch_piece<TEAM>(bit)
-        //                           : internal::fetch_piece_nocache<TEAM>(game, bit);
-        auto piece = internal::fetch_piece_nocache<Game::Team::Black>(game, bit);
-        auto moves = piece.pseudolegal_moves;
-
-        all_attacks |= moves;
-    });
+    while (board) {
+        Bitboard bit = 1ULL << board.popbit();
+        all_attacks |= internal::fetch_piece_nocache<Game::Team::Black>(game, bit).pseudolegal_moves;
+    }
     }
     return all_attacks;
 }
 
-// Early-return boolified version of the prior function (optimization)
-template <Game::Team TEAM>
-bool pseudo_attack_board_has_bit_internal(const Game &game,
-                                          Bitboard mask, bool utilizecache)
+inline Bitboard Game::attackers_to(Bitboard square, Bitboard occupied) const
 {
-    auto board =
-        TEAM == Game::Team::White ? game.positions.whites : game.positions.blacks;
-    auto team = game.current_active_team();
-
-    if(team == Game::Team::White){
-    FOR_BIT(board, {
-        auto piece = internal::fetch_piece_nocache<Game::Team::White>(game, bit);
-
-        // auto piece = utilizecache ? *game.fetch_piece<TEAM>(bit)
-        //                           : internal::fetch_piece_nocache<TEAM>(game, bit);
-        // auto piece = fetch_piece_nocache(game, bit);
-
-        auto moves = piece.pseudolegal_moves;
-        if (moves & mask)
-            return true;
-    });}
-    else{
-        FOR_BIT(board, {
-        auto piece = internal::fetch_piece_nocache<Game::Team::Black>(game, bit);
-
-        // auto piece = utilizecache ? *game.fetch_piece<TEAM>(bit)
-        //                           : internal::fetch_piece_nocache<TEAM>(game, bit);
-        // auto piece = fetch_piece_nocache(game, bit);
+    auto idx = square.trailing_zeroes();
+    // A pawn attacks the square when a pawn of the
+    // other team standing on it would attack the pawn
+    Bitboard pawns = (pseudolegal_calc::pawn_attacks(square, Team::Black) & positions.whites) |
+                     (pseudolegal_calc::pawn_attacks(square, Team::White) & positions.blacks);
+    Bitboard attackers = (pawns & positions.pawns) |
+                         (pseudolegal_calc::knight_moves(square) & positions.knights) |
+                         (pseudolegal_calc::king_moves(square) & positions.kings) |
+                         (Bitboard(Bmagic(idx, (uint64_t)occupied)) & (positions.bishops | positions.queens)) |
+                         (Bitboard(Rmagic(idx, (uint64_t)occupied)) & (positions.rooks | positions.queens));
+    return attackers & occupied;
+}
 
-        auto moves = piece.pseudolegal_moves;
-        if (moves & mask)
+inline bool Game::is_attacked(Team team, Bitboard squares) const
+{
+    auto occupied = positions.whites | positions.blacks;
+    auto enemies = team == Team::White ? positions.blacks : positions.whites;
+    while (squares)
+    {
+        Bitboard square = 1ULL << squares.popbit();
+        if (attackers_to(square, occupied) & enemies)
             return true;
-    });}
+    }
     return false;
 }
+
 template <Game::Team TEAM>
 bool Game::is_mated() const
 {
@@ -109,29 +94,12 @@ template <Game::Team TEAM>
 __attribute__((always_inline)) bool
 is_checked_internal(const Game &game, bool utilizecache)
 {
-    // if (team == Game::Team::Black)
-    //   return game.pseudo_attack_board(Game::Team::White) & game.positions.kings
-    //   &
-    //          game.positions.blacks;
-    // else
-    //   return game.pseudo_attack_board(Game::Team::Black) & game.positions.kings
-    //   &
-    //          game.positions.whites;
-
-    if (TEAM == Game::Team::Black)
-    {
-        auto res = pseudo_attack_board_has_bit_internal<Game::Team::White>(
-            game, game.positions.kings & game.positions.blacks,
-            utilizecache);
-        return res;
-    }
-    else
-    {
-        auto res = pseudo_attack_board_has_bit_internal<Game::Team::Black>(
-            game, game.positions.kings & game.positions.whites,
-            utilizecache);
-        return res;
-    }
+    auto ours = TEAM == Game::Team::White ? game.positions.whites : game.positions.blacks;
+    auto king = game.positions.kings & ours;
+    // Only positions set up by hand can lack a king
+    if (!king)
+        return false;
+    return game.is_attacked(TEAM, king);
 }
 
 template <Game::Team CURRENT_TEAM>
@@ -165,6 +133,16 @@ bool Game::is_checked() const
 }
 inline bool is_legal_move(const Game &game, Game::Piece piece, Bitboard target_pos)
 {
+    // Only the king itself moves, so it is enough that no enemy attacks
+    // the target once the king has left its square (sliders see through
+    // it) and a piece it captures there no longer does
+    if (piece.kind == Game::PieceKind::King)
+    {
+        auto occupied = (game.positions.whites | game.positions.blacks) ^ piece.position;
+        auto enemies = piece.team == Game::Team::White ? game.positions.blacks : game.positions.whites;
+        return !(game.attackers_to(target_pos, occupied) & enemies & ~target_pos);
+    }
+
     auto &m = game.mut();
 
     // Save the state of the game
@@ -175,13 +153,20 @@ inline bool is_legal_move(const Game &game, Game::Piece piece, Bitboard target_p
     auto wk = game.castle.wks;
     auto wq = game.castle.wqs;
     auto zob = game.zobrist_hash;
+    auto accumulators = game.accumulators;
+    auto deltas = game.deltas;
+    auto pawn_hash = game.pawn_hash;
+
+    // Decided before the turn passes below, after which the capturing
+    // pawn no longer belongs to the team to move
+    bool enpassant = piece.kind == Game::PieceKind::Pawn &&
+                     piece.team == game.current_active_team() && target_pos & game.enpassant;
 
     if(piece.team == Game::Team::White)m.state = Game::State::BlackToMove;
     else m.state = Game::State::WhiteToMove;
     // Delete/Kill the captured piece (when applicable)
 
-    if (piece.kind == Game::PieceKind::Pawn &&
-        piece.team == game.current_active_team() && target_pos & game.enpassant)
+    if (enpassant)
     {
         // If the move was an enpassant its slightly different
 
@@ -216,6 +201,9 @@ inline bool is_legal_move(const Game &game, Game::Piece piece, Bitboard target_p
     m.castle.bqs = bq;
     m.castle.bks = bk;
     m.zobrist_hash = zob;
+    m.accumulators = accumulators;
+    m.deltas = deltas;
+    m.pawn_hash = pawn_hash;
     m.state = initial_s;
     return legal;
 }
@@ -289,60 +277,47 @@ Bitboard Game::pseudo_danger_board() const
     return pseudo_attack_board_internal < TEAM == Team::White ? Team::Black : Team::White > (*this, true);
 }
 
-inline bool can_castle_kingside(Game::Team team, Bitboard world, Bitboard attacked,
-                                bool castling_rights)
+//
+// Castling rules:
+// 1. King must not be under attack
+// 2. All positions that the king must cross, must not be under attack
+// 3. All positions between king and rook must not be occupied
+//
+inline bool can_castle_kingside(const Game &game, Game::Team team, bool castling_rights)
 {
     if (!castling_rights)
         return false;
 
+    auto world = game.positions.whites | game.positions.blacks;
     if (team == Game::Team::White)
-    {
-        if (!(attacked & Bitboard::WhiteKingsideCastleMustBeSafe) &&
-            !(world & Bitboard::WhiteKingsideCastleMustBeEmpty))
-            return true;
-    }
+        return !(world & Bitboard::WhiteKingsideCastleMustBeEmpty) &&
+               !game.is_attacked(team, Bitboard::WhiteKingsideCastleMustBeSafe);
     else
-    {
-        if (!(attacked & Bitboard::BlackKingsideCastleMustBeSafe) &&
-            !(world & Bitboard::BlackKingsideCastleMustBeEmpty))
-            return true;
-    }
-    return false;
+        return !(world & Bitboard::BlackKingsideCastleMustBeEmpty) &&
+               !game.is_attacked(team, Bitboard::BlackKingsideCastleMustBeSafe);
 }
 
-inline bool can_castle_queenside(Game::Team team, Bitboard world, Bitboard attacked,
-                                 bool castling_rights)
+inline bool can_castle_queenside(const Game &game, Game::Team team, bool castling_rights)
 {
     if (!castling_rights)
         return false;
 
+    auto world = game.positions.whites | game.positions.blacks;
     if (team == Game::Team::White)
-    {
-        return !(attacked & Bitboard::WhiteQueensideCastleMustBeSafe) &&
-               !(world & Bitboard::WhiteQueensideCastleMustBeEmpty);
-    }
+        return !(world & Bitboard::WhiteQueensideCastleMustBeEmpty) &&
+               !game.is_attacked(team, Bitboard::WhiteQueensideCastleMustBeSafe);
     else
-    {
-        return !(attacked & Bitboard::BlackQueensideCastleMustBeSafe) &&
-               !(world & Bitboard::BlackQueensideCastleMustBeEmpty);
-    }
+        return !(world & Bitboard::BlackQueensideCastleMustBeEmpty) &&
+               !game.is_attacked(team, Bitboard::BlackQueensideCastleMustBeSafe);
 }
 
 template <Game::Team TEAM>
 Bitboard Game::attack_board_incl_castles() const
 {
-    // The rules for castling are a little annoying.
-    // 1. King must not be under attack
-    // 2. All positions that the king must cross, must not be under attack
-    // 3. All positions between king and rook must not be occupied
     auto attacks = attack_board<TEAM>();
-    auto attacked = danger_board<TEAM>();
-    auto world = positions.whites | positions.blacks;
 
-    auto can_kingside = can_castle_kingside(
-        TEAM, world, attacked, TEAM == Team::White ? castle.wks : castle.bks);
-    auto can_queenside = can_castle_queenside(
-        TEAM, world, attacked, TEAM == Team::White ? castle.wqs : castle.bqs);
+    auto can_kingside = can_castle_kingside(*this, TEAM, TEAM == Team::White ? castle.wks : castle.bks);
+    auto can_queenside = can_castle_queenside(*this, TEAM, TEAM == Team::White ? castle.wqs : castle.bqs);
 
     auto row = TEAM == Team::White ? Bitboard::Row1 : Bitboard::Row8;
 
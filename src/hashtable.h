@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+//
+// Relavant Docs:
+// https://www.chessprogramming.org/Shared_Hash_Table#Lock-less
+//
+// The hash tables of the search (transposition.h, evalcache.h, pawns.h)
+// are shared between every search thread. Instead of locking, each slot
+// stores (key ^ data) next to the data itself. A torn write (two threads
+// storing into the same slot at once) makes the xor check fail, so the
+// corrupted entry is simply treated as a miss.
+//
+// Table is the table itself, which packs its Table::Entry into the 64 bits
+// of data with `static uint64_t pack(Entry)` and `static Entry unpack(uint64_t)`
+//
+namespace chess {
+
+template <class Table> class LocklessTable {
+public:
+  explicit LocklessTable(size_t megabytes) { resize(megabytes); }
+
+  // Reallocates (and clears) the table
+  // NOTE: Not safe to call while a search is running
+  void resize(size_t megabytes) {
+    size_t count = (megabytes * 1024 * 1024) / sizeof(Slot);
+    // Round down to a power of two so that we can index with a mask
+    count = count ? std::bit_floor(count) : 1;
+    m_slots = std::make_unique<Slot[]>(count);
+    m_mask = count - 1;
+  }
+
+  // NOTE: Not safe to call while a search is running
+  void clear() {
+    for (uint64_t i = 0; i <= m_mask; i++) {
+      m_slots[i].key.store(0, std::memory_order_relaxed);
+      m_slots[i].data.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  size_t size() const { return m_mask + 1; }
+
+  // Entry is always Table::Entry, which is incomplete where Table derives from this
+  template <class Entry> bool probe(uint64_t key, Entry &out) const {
+    static_assert(std::is_same_v<Entry, typename Table::Entry>);
+    auto &slot = m_slots[key & m_mask];
+    auto data = slot.data.load(std::memory_order_relaxed);
+    auto check = slot.key.load(std::memory_order_relaxed);
+    // An empty slot only matches the (practically impossible) zero key
+    if ((check ^ data) != key || (!check && !data))
+      return false;
+    out = Table::unpack(data);
+    return true;
+  }
+
+  // Always replaces the slot
+  template <class Entry> void store(uint64_t key, const Entry &e) {
+    static_assert(std::is_same_v<Entry, typename Table::Entry>);
+    auto &slot = m_slots[key & m_mask];
+    auto data = Table::pack(e);
+    slot.key.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> key = 0;
+    std::atomic<uint64_t> data = 0;
+  };
+
+  std::unique_ptr<Slot[]> m_slots;
+  uint64_t m_mask = 0;
+};
+
+}; // namespace chess
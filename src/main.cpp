@@ -6,6 +6,8 @@
 #include <future>
 #include "train.h"
 #include "perft.h"
+#include "bench.h"
+#include "uci.h"
 const char *OPENING_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 using namespace chess;
 
@@ -67,6 +69,54 @@ void print_state(Game::State s)
 int main(int argc, char** argv)
 {   
     // std::cout << agents::Weighted().encode() << std::endl;
+    if(argc >= 3 && std::string(argv[1]) == "bench"){
+        auto depth = argc >= 4 ? atoi(argv[3]) : 5;
+        auto game = chess::Game::create(argc >= 5 ? argv[4] : OPENING_FEN);
+        if(std::string(argv[2]) == "smp"){
+            bench_smp(game, depth);
+        }
+        else if(std::string(argv[2]) == "pruning"){
+            bench_pruning(game, depth);
+        }
+        else if(std::string(argv[2]) == "batch"){
+            bench_batch(game, depth);
+        }
+        else if(std::string(argv[2]) == "nnue"){
+            bench_nnue(game, depth);
+        }
+        else{
+            std::cerr << "Unknown benchmark: " << argv[2] << std::endl;
+            exit(1);
+        }
+        return 0;
+    }
+    // Tune the weights of an agent (the default one without a file) by gradient descent, see train.h
+    if(argc >= 2 && std::string(argv[1]) == "tune"){
+        texel_tune(argc >= 3 ? argv[2] : "", argc >= 4 ? argv[3] : "tuned.agent");
+        return 0;
+    }
+    // Optimize the weights of an agent with CMA-ES, resuming from the state file when there is one
+    if(argc >= 2 && std::string(argv[1]) == "cmaes"){
+        cmaes_train(argc >= 3 ? argv[2] : "", argc >= 4 ? argv[3] : "cmaes.state");
+        return 0;
+    }
+    // Convert FEN/EPD positions with results into a dataset file (see dataset.h)
+    if(argc >= 2 && std::string(argv[1]) == "convert"){
+        if(argc < 4){
+            std::cerr << "Expected an input and an output file" << std::endl;
+            exit(1);
+        }
+        chess::dataset::ParseStats stats;
+        auto count = chess::dataset::convert(argv[2], argv[3], &stats);
+        std::cout << "Converted " << count << " positions (" << stats.skipped << " lines skipped, "
+                  << stats.duplicates << " duplicates)" << std::endl;
+        return 0;
+    }
+    // Without arguments, talk UCI to whatever GUI started us
+    if(argc == 1 || std::string(argv[1]) == "uci"){
+        Uci().run();
+        return 0;
+    }
     if(argc < 3){
         std::cerr << "Bad Arg Count, Expected FEN string and depth" << std::endl;
         exit(1);
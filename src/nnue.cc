@@ -0,0 +1,218 @@
+#include "./nnue.h"
+#include "./error.h"
+#include "./simd.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+using namespace chess;
+using namespace chess::nnue;
+
+namespace {
+
+constexpr char MAGIC[4] = {'N', 'N', 'U', 'E'};
+constexpr uint32_t VERSION = 1;
+
+SIMD_KERNEL void add_row(int16_t *__restrict acc, const int16_t *__restrict row) {
+  for (int i = 0; i < HALF; i++)
+    acc[i] += row[i];
+}
+
+SIMD_KERNEL void sub_row(int16_t *__restrict acc, const int16_t *__restrict row) {
+  for (int i = 0; i < HALF; i++)
+    acc[i] -= row[i];
+}
+
+SIMD_KERNEL void clipped_relu(const int16_t *__restrict in, uint8_t *__restrict out) {
+  for (int i = 0; i < HALF; i++)
+    out[i] = std::clamp<int16_t>(in[i], 0, ACTIVATION_MAX);
+}
+
+// out = ClippedReLU((in . weights + bias) >> WEIGHT_SHIFT)
+// Most activations are 0, their weight rows are skipped
+SIMD_KERNEL void affine(const uint8_t *__restrict in, const int8_t *__restrict weights,
+                        const int32_t *__restrict bias, uint8_t *__restrict out, int inputs) {
+  int32_t sums[HIDDEN];
+  for (int o = 0; o < HIDDEN; o++)
+    sums[o] = bias[o];
+  for (int i = 0; i < inputs; i++) {
+    if (!in[i])
+      continue;
+    const int8_t *row = weights + i * HIDDEN;
+    for (int o = 0; o < HIDDEN; o++)
+      sums[o] += (int32_t)row[o] * in[i];
+  }
+  for (int o = 0; o < HIDDEN; o++)
+    out[o] = std::clamp<int32_t>(sums[o] >> WEIGHT_SHIFT, 0, ACTIVATION_MAX);
+}
+
+int king_square(const Game &game, Game::Team team) {
+  auto ours = team == Game::Team::White ? game.positions.whites : game.positions.blacks;
+  return (game.positions.kings & ours).trailing_zeroes();
+}
+
+void check_endianness() {
+  if constexpr (std::endian::native != std::endian::little)
+    throw chess::Error("NNUE files can only be read and written on little endian machines");
+}
+
+template <class T> void read(std::ifstream &in, T *data, size_t n, const std::string &path) {
+  if (!in.read(reinterpret_cast<char *>(data), n * sizeof(T)))
+    throw chess::Error("Truncated network file: " + path);
+}
+
+template <class T> void write(std::ofstream &out, const T *data, size_t n) {
+  out.write(reinterpret_cast<const char *>(data), n * sizeof(T));
+}
+
+}; // namespace
+
+Network Network::load(const std::string &path) {
+  check_endianness();
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw chess::Error("Could not open network file: " + path);
+
+  char magic[4];
+  uint32_t header[4];
+  read(in, magic, 4, path);
+  read(in, header, 4, path);
+  if (std::memcmp(magic, MAGIC, 4) != 0)
+    throw chess::Error("Not a network file: " + path);
+  if (header[0] != VERSION)
+    throw chess::Error("Unsupported network version " + std::to_string(header[0]) + ": " + path);
+  if (header[1] != INPUTS || header[2] != HALF || header[3] != HIDDEN)
+    throw chess::Error("Network file has the wrong layer sizes: " + path);
+
+  Network net;
+  read(in, net.feature_weights.data(), net.feature_weights.size(), path);
+  read(in, net.feature_bias.data(), net.feature_bias.size(), path);
+  read(in, net.hidden1_weights.data(), net.hidden1_weights.size(), path);
+  read(in, net.hidden1_bias.data(), net.hidden1_bias.size(), path);
+  read(in, net.hidden2_weights.data(), net.hidden2_weights.size(), path);
+  read(in, net.hidden2_bias.data(), net.hidden2_bias.size(), path);
+  read(in, net.output_weights.data(), net.output_weights.size(), path);
+  read(in, &net.output_bias, 1, path);
+  return net;
+}
+
+void Network::save(const std::string &path) const {
+  check_endianness();
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+    throw chess::Error("Could not create network file: " + path);
+
+  const uint32_t header[4] = {VERSION, INPUTS, HALF, HIDDEN};
+  write(out, MAGIC, 4);
+  write(out, header, 4);
+  write(out, feature_weights.data(), feature_weights.size());
+  write(out, feature_bias.data(), feature_bias.size());
+  write(out, hidden1_weights.data(), hidden1_weights.size());
+  write(out, hidden1_bias.data(), hidden1_bias.size());
+  write(out, hidden2_weights.data(), hidden2_weights.size());
+  write(out, hidden2_bias.data(), hidden2_bias.size());
+  write(out, output_weights.data(), output_weights.size());
+  write(out, &output_bias, 1);
+  if (!out)
+    throw chess::Error("Could not write network file: " + path);
+}
+
+Network Network::material() {
+  // In thirds of a pawn (so that a full set of pieces stays under
+  // ACTIVATION_MAX), indexed by Game::PieceKind
+  constexpr int16_t VALUES[5] = {3, 9, 15, 9, 27};
+  constexpr int8_t ONE = 1 << WEIGHT_SHIFT;
+
+  Network net;
+  // Accumulator: [0] our material, [1] theirs
+  for (int king = 0; king < KING_SQUARES; king++)
+    for (int piece = 0; piece < PIECES; piece++)
+      for (int square = 0; square < 64; square++) {
+        auto *row = &net.feature_weights[(size_t)((king * PIECES + piece) * 64 + square) * HALF];
+        row[piece < 5 ? 0 : 1] = VALUES[piece % 5];
+      }
+
+  // Hidden: [0] how far the side to move is ahead, [1] how far behind
+  net.hidden1_weights[0 * HIDDEN + 0] = ONE;
+  net.hidden1_weights[1 * HIDDEN + 0] = -ONE;
+  net.hidden1_weights[0 * HIDDEN + 1] = -ONE;
+  net.hidden1_weights[1 * HIDDEN + 1] = ONE;
+  net.hidden2_weights[0 * HIDDEN + 0] = ONE;
+  net.hidden2_weights[1 * HIDDEN + 1] = ONE;
+  // Roughly 100 centipawns a pawn
+  net.output_weights[0] = 127;
+  net.output_weights[1] = -127;
+  return net;
+}
+
+void nnue::refresh(const Network &net, const Game &game, Game::Team perspective, Accumulator &acc) {
+  auto &values = acc.values[(int)perspective];
+  values = net.feature_bias;
+  auto king = king_square(game, perspective);
+
+  auto add = [&](Bitboard kind_board, Game::PieceKind kind) {
+    for (auto team : {Game::Team::White, Game::Team::Black}) {
+      Bitboard board = kind_board & (team == Game::Team::White ? game.positions.whites : game.positions.blacks);
+      while (board) {
+        auto square = board.popbit();
+        add_row(values.data(), &net.feature_weights[(size_t)feature(perspective, king, square, kind, team) * HALF]);
+      }
+    }
+  };
+  add(game.positions.pawns, Game::PieceKind::Pawn);
+  add(game.positions.bishops, Game::PieceKind::Bishop);
+  add(game.positions.rooks, Game::PieceKind::Rook);
+  add(game.positions.knights, Game::PieceKind::Knight);
+  add(game.positions.queens, Game::PieceKind::Queen);
+}
+
+void nnue::refresh(const Network &net, const Game &game, Accumulator &acc) {
+  refresh(net, game, Game::Team::White, acc);
+  refresh(net, game, Game::Team::Black, acc);
+}
+
+void nnue::update(const Network &net, const Game &game, const Accumulator &from, Accumulator &to) {
+  auto &deltas = game.deltas;
+  for (auto perspective : {Game::Team::White, Game::Team::Black}) {
+    // Every input of a perspective depends on where its king stands
+    bool king_moved = deltas.overflowed;
+    for (int i = 0; i < deltas.count; i++)
+      king_moved |= deltas.items[i].kind == Game::PieceKind::King && deltas.items[i].team == perspective;
+    if (king_moved) {
+      refresh(net, game, perspective, to);
+      continue;
+    }
+
+    auto &values = to.values[(int)perspective];
+    values = from.values[(int)perspective];
+    auto king = king_square(game, perspective);
+    for (int i = 0; i < deltas.count; i++) {
+      auto &d = deltas.items[i];
+      if (d.kind == Game::PieceKind::King)
+        continue;
+      auto *row = &net.feature_weights[(size_t)feature(perspective, king, d.square, d.kind, d.team) * HALF];
+      if (d.added)
+        add_row(values.data(), row);
+      else
+        sub_row(values.data(), row);
+    }
+  }
+}
+
+int32_t nnue::evaluate(const Network &net, const Accumulator &acc, Game::Team to_move) {
+  alignas(64) uint8_t input[2 * HALF];
+  alignas(64) uint8_t hidden1[HIDDEN];
+  alignas(64) uint8_t hidden2[HIDDEN];
+
+  auto them = to_move == Game::Team::White ? Game::Team::Black : Game::Team::White;
+  clipped_relu(acc.values[(int)to_move].data(), input);
+  clipped_relu(acc.values[(int)them].data(), input + HALF);
+  affine(input, net.hidden1_weights.data(), net.hidden1_bias.data(), hidden1, 2 * HALF);
+  affine(hidden1, net.hidden2_weights.data(), net.hidden2_bias.data(), hidden2, HIDDEN);
+
+  int32_t output = net.output_bias;
+  for (int i = 0; i < HIDDEN; i++)
+    output += (int32_t)net.output_weights[i] * hidden2[i];
+  return output / OUTPUT_SCALE;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "./game.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Efficiently updatable neural network (NNUE) evaluation
+ *
+ * The inputs are HalfKP features: for each perspective (team), one input per
+ * (own king square, piece, square) for every piece but the kings, seen from
+ * that team's side of the board (black's squares are mirrored vertically).
+ * A move only turns on and off a handful of inputs, so the first layer is
+ * not recomputed at every node: its output (the accumulator) is updated from
+ * the parent's by adding and subtracting the weight rows of the pieces that
+ * moved, as logged by Game::deltas. Only a king move forces that team's half
+ * to be refreshed from scratch.
+ *
+ *   features (2 x 40960) -> accumulator (2 x 128, int16)
+ *     -> ClippedReLU -> 32 (int8 weights) -> ClippedReLU -> 32 (int8)
+ *     -> ClippedReLU -> 1
+ *
+ * The side to move's half of the accumulator comes first. Everything is
+ * integer arithmetic, activations are clipped to [0, ACTIVATION_MAX] and the
+ * hidden layers' weights are fixed point with WEIGHT_SHIFT fractional bits.
+ *
+ * The kernels are plain loops the compiler vectorizes, with AVX2 and
+ * AVX-512 clones where available (see SIMD_KERNEL in simd.h).
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/NNUE
+ * https://www.chessprogramming.org/Stockfish_NNUE
+ *
+ * */
+namespace chess::nnue {
+
+constexpr int KING_SQUARES = 64;
+// Every kind but the king, ours then theirs
+constexpr int PIECES = 10;
+constexpr int INPUTS = KING_SQUARES * PIECES * 64;
+// Accumulator size, per perspective
+constexpr int HALF = 128;
+constexpr int HIDDEN = 32;
+
+constexpr int32_t ACTIVATION_MAX = 127;
+constexpr int WEIGHT_SHIFT = 6;
+// The output is in 1/OUTPUT_SCALE centipawns
+constexpr int32_t OUTPUT_SCALE = 4;
+
+struct Network {
+  // [INPUTS][HALF]
+  std::vector<int16_t> feature_weights;
+  std::array<int16_t, HALF> feature_bias{};
+  // [2 * HALF][HIDDEN], one row per input
+  std::array<int8_t, HIDDEN * 2 * HALF> hidden1_weights{};
+  std::array<int32_t, HIDDEN> hidden1_bias{};
+  // [HIDDEN][HIDDEN], one row per input
+  std::array<int8_t, HIDDEN * HIDDEN> hidden2_weights{};
+  std::array<int32_t, HIDDEN> hidden2_bias{};
+  std::array<int8_t, HIDDEN> output_weights{};
+  int32_t output_bias = 0;
+
+  Network() : feature_weights((size_t)INPUTS * HALF) {}
+
+  //
+  // Networks are stored as a small header ("NNUE", version, and the layer
+  // sizes as little endian uint32) followed by every member above, in
+  // order, as raw little endian arrays
+  //
+  static Network load(const std::string &path);
+  void save(const std::string &path) const;
+
+  // An untrained network which only counts material,
+  // used when no network file is given
+  static Network material();
+};
+
+// First layer output of a position, indexed by Game::Team (the perspective)
+struct Accumulator {
+  alignas(64) std::array<std::array<int16_t, HALF>, 2> values;
+
+  bool operator==(const Accumulator &o) const = default;
+};
+
+// Input index of a (non-king) piece as seen by perspective
+inline int feature(Game::Team perspective, int king, int square, Game::PieceKind kind, Game::Team team) {
+  if (perspective == Game::Team::Black) {
+    king ^= 56;
+    square ^= 56;
+  }
+  int piece = (int)kind + (team == perspective ? 0 : 5);
+  return (king * PIECES + piece) * 64 + square;
+}
+
+// Compute one half of the accumulator from scratch
+void refresh(const Network &net, const Game &game, Game::Team perspective, Accumulator &acc);
+void refresh(const Network &net, const Game &game, Accumulator &acc);
+
+// Update the accumulator of the position game.deltas were logged from
+// to the current position
+void update(const Network &net, const Game &game, const Accumulator &from, Accumulator &to);
+
+// Evaluation in centipawns, for the team to move
+int32_t evaluate(const Network &net, const Accumulator &acc, Game::Team to_move);
+
+}; // namespace chess::nnue
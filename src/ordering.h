@@ -0,0 +1,176 @@
+#pragma once
+#include "./game.h"
+#include "./evaluate.h"
+#include "./see.h"
+#include <array>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Move ordering for the search
+ *
+ * Alpha-beta prunes the most when the best move is searched first, so moves
+ * are scored and sorted before they are searched, in tiers:
+ *
+ * 1. The best move stored in the transposition table
+ * 2. Captures and queen promotions, by MVV-LVA
+ *    (Most Valuable Victim, Least Valuable Attacker)
+ * 3. Killer moves, quiet moves which caused a beta cutoff at the same ply
+ * 4. Remaining quiet moves, by their history score
+ * 5. Captures which lose material in the exchange (see see.h), by MVV-LVA
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/Move_Ordering
+ * https://www.chessprogramming.org/MVV-LVA
+ * https://www.chessprogramming.org/Static_Exchange_Evaluation
+ * https://www.chessprogramming.org/Killer_Heuristic
+ * https://www.chessprogramming.org/History_Heuristic
+ *
+ * */
+namespace chess {
+
+class MoveOrdering {
+public:
+  static constexpr int MAX_PLY = 128;
+
+  static bool is_quiet(const Game::Move &m) {
+    switch (m.kind) {
+    case Game::Move::Capture:
+    case Game::Move::Enpassant:
+    case Game::Move::PromoteQueen:
+    case Game::Move::PromoteKnight:
+    case Game::Move::PromoteRook:
+    case Game::Move::PromoteBishop:
+      return false;
+    default:
+      return true;
+    }
+  }
+
+  // Value of the material a tactical move wins (0 for quiet moves)
+  static float gain(const Game &game, const Game::Move &m,
+                    const evaluators::PerPiece &values) {
+    float gain = 0;
+    if (m.kind == Game::Move::Enpassant)
+      gain = values.pawn;
+    else if (auto victim = game.fetch_piece(m.target_pos);
+             victim && victim->team != m.piece->team)
+      gain = values.of(victim->kind);
+    if (m.kind == Game::Move::PromoteQueen)
+      gain += values.queen - values.pawn;
+    return gain;
+  }
+
+  // Whether the exchanges a tactical move starts lose material
+  static bool is_losing(const Game &game, const Game::Move &m,
+                        const evaluators::PerPiece &values) {
+    // Even if the attacker is recaptured, taking a piece
+    // worth at least as much can't lose anything
+    if (gain(game, m, values) >= values.of(m.piece->kind))
+      return false;
+    return see::evaluate(game, m, values) < 0;
+  }
+
+  // Sort the moves from most to least promising
+  void order(const Game &game, std::vector<Game::Move> &moves, int ply,
+             uint16_t tt_move, const evaluators::PerPiece &values) const {
+    const double TT_SCORE = 4e12;
+    const double TACTICAL_SCORE = 2e12;
+    const double KILLER_SCORE = 1e12;
+    // History scores are never negative
+    const double LOSING_SCORE = -1e12;
+
+    std::vector<std::pair<double, size_t>> scored;
+    scored.reserve(moves.size());
+    auto &ply_killers = killers[std::min(ply, MAX_PLY - 1)];
+
+    for (size_t i = 0; i < moves.size(); i++) {
+      auto &m = moves[i];
+      auto packed = m.packed();
+      double score;
+      if (packed == tt_move)
+        score = TT_SCORE;
+      else if (!is_quiet(m))
+        score = (is_losing(game, m, values) ? LOSING_SCORE : TACTICAL_SCORE) +
+                gain(game, m, values) * 1000 - values.of(m.piece->kind);
+      else if (packed == ply_killers[0])
+        score = KILLER_SCORE + 1;
+      else if (packed == ply_killers[1])
+        score = KILLER_SCORE;
+      else
+        score = history_score(m);
+      scored.push_back({score, i});
+    }
+    std::stable_sort(scored.begin(), scored.end(),
+                     [](auto &a, auto &b) { return a.first > b.first; });
+
+    std::vector<Game::Move> sorted;
+    sorted.reserve(moves.size());
+    for (auto &s : scored)
+      sorted.push_back(moves[s.second]);
+    moves = std::move(sorted);
+  }
+
+  // Only order captures by MVV-LVA (quiescence search)
+  static void order_tactical(const Game &game, std::vector<Game::Move> &moves,
+                             const evaluators::PerPiece &values) {
+    std::vector<std::pair<float, size_t>> scored;
+    scored.reserve(moves.size());
+    for (size_t i = 0; i < moves.size(); i++) {
+      scored.push_back({gain(game, moves[i], values) * 1000 -
+                            values.of(moves[i].piece->kind),
+                        i});
+    }
+    std::stable_sort(scored.begin(), scored.end(),
+                     [](auto &a, auto &b) { return a.first > b.first; });
+    std::vector<Game::Move> sorted;
+    sorted.reserve(moves.size());
+    for (auto &s : scored)
+      sorted.push_back(moves[s.second]);
+    moves = std::move(sorted);
+  }
+
+  // Called when a move causes a beta cutoff
+  void on_cutoff(const Game::Move &m, int ply, int depth) {
+    if (!is_quiet(m))
+      return;
+    auto packed = m.packed();
+    auto &ply_killers = killers[std::min(ply, MAX_PLY - 1)];
+    if (ply_killers[0] != packed) {
+      ply_killers[1] = ply_killers[0];
+      ply_killers[0] = packed;
+    }
+
+    auto &h = history[(int)m.piece->team][m.source_pos.trailing_zeroes()]
+                     [m.target_pos.trailing_zeroes()];
+    h += depth * depth;
+
+    // Keep the scores bounded, halving keeps the relative order intact
+    if (h >= HISTORY_MAX) {
+      for (auto &team : history)
+        for (auto &from : team)
+          for (auto &to : from)
+            to /= 2;
+    }
+  }
+
+  void clear() {
+    killers = {};
+    history = {};
+  }
+
+private:
+  static constexpr int32_t HISTORY_MAX = 1 << 24;
+
+  int32_t history_score(const Game::Move &m) const {
+    return history[(int)m.piece->team][m.source_pos.trailing_zeroes()]
+                  [m.target_pos.trailing_zeroes()];
+  }
+
+  std::array<std::array<uint16_t, 2>, MAX_PLY> killers{};
+
+  // Butterfly board, indexed by [team][from][to]
+  std::array<std::array<std::array<int32_t, 64>, 64>, 2> history{};
+};
+
+}; // namespace chess
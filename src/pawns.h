@@ -0,0 +1,93 @@
+#pragma once
+
+#include "./evaluate.h"
+#include "./game.h"
+#include "./hashtable.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+//
+// Relavant Docs:
+// https://www.chessprogramming.org/Pawn_Hash_Table
+//
+// The pawn terms of the evaluation only depend on where the pawns (and the
+// kings) stand, which rarely changes within a search tree. They are cached
+// by Game::pawn_hash, so most nodes find them without looking at a pawn.
+//
+// The terms are stored unweighted, so the table stays valid for any agent
+// and can be shared like the transposition table (see hashtable.h).
+//
+namespace chess {
+
+struct PawnStructure {
+  struct Terms {
+    uint8_t development = 0;
+    uint8_t king_front = 0;
+    uint8_t passed = 0;
+    uint8_t isolated = 0;
+    uint8_t doubled = 0;
+  };
+  // Indexed by Game::Team
+  std::array<Terms, 2> teams;
+
+  const Terms &of(Game::Team team) const { return teams[(int)team]; }
+
+  static PawnStructure evaluate(const Game &game) {
+    PawnStructure ps;
+    for (auto team : {Game::Team::White, Game::Team::Black}) {
+      auto &t = ps.teams[(int)team];
+      t.development = evaluators::pawn_development(game, team);
+      t.king_front = evaluators::king_front_pawns(game, team);
+      t.passed = evaluators::passed_pawns(game, team);
+      t.isolated = evaluators::isolated_pawns(game, team);
+      t.doubled = evaluators::doubled_pawns(game, team);
+    }
+    return ps;
+  }
+};
+
+class PawnTable : public LocklessTable<PawnTable> {
+public:
+  using Entry = PawnStructure;
+
+  explicit PawnTable(size_t megabytes = 1) : LocklessTable(megabytes) {}
+
+private:
+  friend LocklessTable;
+
+  // LAYOUT (per team, white in the low half):
+  // [ 0.. 7] development
+  // [ 8..11] king front pawns
+  // [12..15] passed
+  // [16..19] isolated
+  // [20..23] doubled
+  static uint64_t pack(const PawnStructure &ps) {
+    uint64_t data = 0;
+    for (int t = 0; t < 2; t++) {
+      auto &terms = ps.teams[t];
+      uint64_t half = terms.development |
+                      (std::min<uint64_t>(terms.king_front, 15) << 8) |
+                      (std::min<uint64_t>(terms.passed, 15) << 12) |
+                      (std::min<uint64_t>(terms.isolated, 15) << 16) |
+                      (std::min<uint64_t>(terms.doubled, 15) << 20);
+      data |= half << (32 * t);
+    }
+    return data;
+  }
+  static PawnStructure unpack(uint64_t data) {
+    PawnStructure ps;
+    for (int t = 0; t < 2; t++) {
+      auto half = data >> (32 * t);
+      auto &terms = ps.teams[t];
+      terms.development = half & 0xFF;
+      terms.king_front = (half >> 8) & 0xF;
+      terms.passed = (half >> 12) & 0xF;
+      terms.isolated = (half >> 16) & 0xF;
+      terms.doubled = (half >> 20) & 0xF;
+    }
+    return ps;
+  }
+};
+
+}; // namespace chess
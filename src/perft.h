@@ -13,7 +13,7 @@ after n moves
 This is similar to shannon's number calculations
 */
 
-size_t perft(const chess::Game& game, int depth){
+inline size_t perft(const chess::Game& game, int depth){
 
     using chess::Game;
 
@@ -0,0 +1,112 @@
+#pragma once
+#include "./game.h"
+#include "./agents/weighted.h"
+#include <optional>
+#include <thread>
+
+/*
+ * Pondering, thinking on the opponent's time
+ *
+ * After the agent has moved, its principal variation predicts the
+ * opponent's reply. The position after that reply is searched in a
+ * background thread until the opponent actually moves:
+ *
+ * - Ponder hit:  the opponent played the expected move, the running search
+ *                is given the agent's normal depth and carries on with
+ *                everything it (and the transposition table) already has
+ * - Ponder miss: the search is aborted, the table still keeps whatever
+ *                transpositions it found
+ *
+ * NOTE: The agent must not be used for anything else while it ponders
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/Pondering
+ *
+ * */
+namespace chess {
+
+class Ponderer {
+public:
+  using Weighted = agents::Weighted;
+
+  explicit Ponderer(const Weighted &agent) : m_agent(agent) {}
+  Ponderer(const Ponderer &) = delete;
+  Ponderer &operator=(const Ponderer &) = delete;
+  ~Ponderer() { stop(); }
+
+  // Start pondering on `game`, the position right after the agent's move,
+  // expecting the reply predicted by the agent's last search
+  // returns false when there is no prediction to ponder on
+  bool start(const Game &game) {
+    auto &pv = m_agent.last_search.pv;
+    if (pv.size() < 2)
+      return false;
+    return start(game, pv[1]);
+  }
+
+  // Start pondering on `game` followed by the expected reply (see Move::packed)
+  bool start(const Game &game, uint16_t expected_reply) {
+    stop();
+    auto reply = game.find_move(expected_reply);
+    if (!reply)
+      return false;
+
+    m_position.emplace(game);
+    m_position->make_move(*m_position->find_move(expected_reply));
+    m_control.stop = false;
+    m_control.completed_depth = 0;
+    // Effectively unbounded until the opponent moves
+    m_control.max_depth = MoveOrdering::MAX_PLY - 1;
+    m_thread = std::thread([this]() { m_result = m_agent.search(*m_position, m_control); });
+    return true;
+  }
+
+  // The opponent has moved, `game` is the resulting position
+  // On a hit, waits for the search to reach the agent's depth and returns
+  // its result, with the best move resolved into `game`
+  // On a miss the search is stopped and nothing is returned
+  std::optional<Weighted::SearchResult> ponderhit(const Game &game) {
+    if (!active())
+      return std::nullopt;
+    if (game.zobrist_hash != m_position->zobrist_hash) {
+      stop();
+      return std::nullopt;
+    }
+
+    m_control.max_depth = m_agent.search_depth;
+    // Already searched deep enough, whatever iteration runs now is extra
+    if (m_control.completed_depth >= m_agent.search_depth)
+      m_control.stop = true;
+    m_thread.join();
+    m_position.reset();
+
+    auto bestmove = game.find_move(m_result.bestmove.packed());
+    if (!bestmove)
+      return std::nullopt;
+    m_result.bestmove = *bestmove;
+    return m_result;
+  }
+
+  // Abort the search (if any) and wait for it
+  void stop() {
+    if (!m_thread.joinable())
+      return;
+    m_control.stop = true;
+    m_thread.join();
+    m_position.reset();
+  }
+
+  bool active() const { return m_thread.joinable(); }
+
+  // The position being pondered on (only valid while active)
+  const Game &position() const { return *m_position; }
+
+private:
+  const Weighted &m_agent;
+  std::optional<Game> m_position;
+  Weighted::SearchControl m_control;
+  Weighted::SearchResult m_result;
+  std::thread m_thread;
+};
+
+}; // namespace chess
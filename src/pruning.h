@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "./score.h"
+
+/*
+ * Tunables for the selective parts of the search
+ *
+ * Every technique can be switched off at runtime, so that the
+ * search can be A/B tested with and without it
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/Null_Move_Pruning
+ * https://www.chessprogramming.org/Late_Move_Reductions
+ * https://www.chessprogramming.org/Futility_Pruning
+ * https://www.chessprogramming.org/Razoring
+ * https://www.chessprogramming.org/Static_Exchange_Evaluation
+ *
+ * */
+namespace chess {
+
+struct PruningSettings {
+  static constexpr int MAX_DEPTH = 32;
+  static constexpr int MAX_MOVES = 64;
+
+  //
+  // Null move pruning
+  // Give the opponent a free move, if we are still above beta after a
+  // reduced search, the real moves surely are as well
+  //
+  bool null_move = true;
+  int null_move_min_depth = 3;
+  // When remaining depth is at least this, a null move cutoff is first
+  // verified by a reduced search of the real moves
+  int null_move_verify_depth = 6;
+  // Depth reduction (R), indexed by remaining depth
+  std::array<uint8_t, MAX_DEPTH> null_move_reduction;
+
+  //
+  // Late move reductions
+  // Quiet moves ordered late are searched at a reduced depth first, and
+  // only re-searched at full depth when they beat the current bound
+  //
+  bool late_move_reductions = true;
+  int lmr_min_depth = 3;
+  // Number of moves searched at full depth before reducing
+  int lmr_full_depth_moves = 3;
+  // Depth reduction, indexed by [remaining depth][move number]
+  std::array<std::array<uint8_t, MAX_MOVES>, MAX_DEPTH> lmr_reduction;
+
+  static constexpr int MAX_FRONTIER_DEPTH = 8;
+
+  //
+  // Futility pruning
+  // Near the leaves, when the static evaluation plus a margin still can't
+  // reach alpha, quiet moves (which don't give check) are not searched
+  //
+  bool futility = true;
+  int futility_max_depth = 2;
+
+  //
+  // Razoring
+  // One step further from the leaves, when the static evaluation plus a margin
+  // is below alpha, a quiescence search decides whether the node is dropped
+  //
+  bool razoring = true;
+  int razoring_max_depth = 3;
+
+  //
+  // SEE pruning
+  // The quiescence search skips captures which lose material once every
+  // recapture on their square is played out (see see.h)
+  //
+  bool see_pruning = true;
+
+  // Margins are in pawns, indexed by remaining depth. The search converts
+  // them into score units for every stage of the game (see Margins)
+  std::array<float, MAX_FRONTIER_DEPTH> futility_margin = {0, 1.5, 3};
+  std::array<float, MAX_FRONTIER_DEPTH> razor_margin = {0, 0, 0, 4};
+
+  // The margins in the score units of one stage, where a pawn is worth
+  // pawn (see Weighted::pawn_score)
+  struct Margins {
+    std::array<Score, MAX_FRONTIER_DEPTH> futility{};
+    std::array<Score, MAX_FRONTIER_DEPTH> razor{};
+
+    Score futility_at(int depth) const { return futility[std::min(depth, MAX_FRONTIER_DEPTH - 1)]; }
+    Score razor_at(int depth) const { return razor[std::min(depth, MAX_FRONTIER_DEPTH - 1)]; }
+  };
+  Margins margins(Score pawn) const {
+    Margins m;
+    for (int d = 0; d < MAX_FRONTIER_DEPTH; d++) {
+      m.futility[d] = scores::from_pawns(futility_margin[d], pawn);
+      m.razor[d] = scores::from_pawns(razor_margin[d], pawn);
+    }
+    return m;
+  }
+
+  PruningSettings() {
+    for (int d = 0; d < MAX_DEPTH; d++)
+      null_move_reduction[d] = d >= 7 ? 3 : 2;
+    set_lmr_table(0.75, 2.25);
+  }
+
+  // reduction = base + ln(depth) * ln(move number) / divisor
+  void set_lmr_table(float base, float divisor) {
+    for (int d = 0; d < MAX_DEPTH; d++) {
+      for (int m = 0; m < MAX_MOVES; m++) {
+        float r = d && m ? base + std::log((float)d) * std::log((float)m) / divisor : 0;
+        lmr_reduction[d][m] = std::clamp((int)r, 0, 255);
+      }
+    }
+  }
+
+  int null_reduction(int depth) const {
+    return null_move_reduction[std::min(depth, MAX_DEPTH - 1)];
+  }
+  int late_move_reduction(int depth, int move_number) const {
+    return lmr_reduction[std::min(depth, MAX_DEPTH - 1)]
+                        [std::min(move_number, MAX_MOVES - 1)];
+  }
+};
+
+//
+// How often each technique kicked in during a search
+//
+struct PruningStats {
+  uint64_t null_move_tries = 0;
+  uint64_t null_move_cutoffs = 0;
+  uint64_t lmr_reductions = 0;
+  uint64_t lmr_researches = 0;
+  uint64_t futility_pruned = 0;
+  uint64_t razor_tries = 0;
+  uint64_t razor_cutoffs = 0;
+  uint64_t delta_pruned = 0;
+  uint64_t see_pruned = 0;
+
+  PruningStats &operator+=(const PruningStats &o) {
+    null_move_tries += o.null_move_tries;
+    null_move_cutoffs += o.null_move_cutoffs;
+    lmr_reductions += o.lmr_reductions;
+    lmr_researches += o.lmr_researches;
+    futility_pruned += o.futility_pruned;
+    razor_tries += o.razor_tries;
+    razor_cutoffs += o.razor_cutoffs;
+    delta_pruned += o.delta_pruned;
+    see_pruned += o.see_pruned;
+    return *this;
+  }
+};
+
+}; // namespace chess
@@ -171,6 +171,10 @@ pseudolegal_calc::knight_moves(Bitboard position) {
   return knight_moves_table[position.trailing_zeroes()];
 }
 INLINE Bitboard
+pseudolegal_calc::pawn_attacks(Bitboard position, Game::Team team) {
+  return (team == Game::Team::White ? white_pawn_attacks : black_pawn_attacks)[position.trailing_zeroes()];
+}
+INLINE Bitboard
 pseudolegal_calc::pawn_moves(Bitboard position, Game::Team team,
                              Bitboard world) {
   Bitboard empties = ~world;
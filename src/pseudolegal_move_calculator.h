@@ -9,6 +9,8 @@ Bitboard knight_moves(Bitboard position);
 Bitboard rook_moves(Bitboard position, Bitboard world);
 Bitboard bishop_moves(Bitboard position, Bitboard world);
 Bitboard queen_moves(Bitboard position, Bitboard world);
+// Squares a pawn of the given team attacks, whether occupied or not
+Bitboard pawn_attacks(Bitboard position, Game::Team team);
 
 
 Bitboard parallel_pawn_moves(Bitboard pawns, Game::Team team, Bitboard world);
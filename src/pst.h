@@ -254,4 +254,30 @@ std::array<int, 64> &scoring_table() {
     }
   }
 }
+
+// Same as above, but with the scenario only known at runtime
+inline std::array<int, 64> &scoring_table(Game::Team team, Game::PieceKind kind,
+                                          Game::GameStage stage) {
+#define KIND(team, kind)                                                       \
+  case kind:                                                                   \
+    return stage == Game::GameStage::Endgame                                   \
+               ? scoring_table<team, kind, Game::GameStage::Endgame>()         \
+               : scoring_table<team, kind, Game::GameStage::MidGame>();
+#define TEAM(team)                                                             \
+  switch (kind) {                                                              \
+    KIND(team, Game::PieceKind::Pawn)                                          \
+    KIND(team, Game::PieceKind::Bishop)                                        \
+    KIND(team, Game::PieceKind::Rook)                                          \
+    KIND(team, Game::PieceKind::Knight)                                        \
+    KIND(team, Game::PieceKind::Queen)                                         \
+    KIND(team, Game::PieceKind::King)                                          \
+  }
+  if (team == Game::Team::White)
+    TEAM(Game::Team::White)
+  else
+    TEAM(Game::Team::Black)
+#undef TEAM
+#undef KIND
+  return midgame::pawn_table_white;
+}
 }; // namespace chess::piece_square_tables
@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+//
+// The score domain of the search
+//
+// A score is the difference between the weighted sums of the team to move
+// and its enemy (see Weighted::leaf_eval), in the units of the weights.
+// These are not centipawns: every term is scaled by its own weight, and a
+// pawn is worth its value times the material weight of the stage (see
+// Weighted::pawn_score), which UCI reports convert by. Margins of the search
+// are given in pawns for the same reason, and converted per agent and stage
+// with from_pawns. Being plain integers, scores negate exactly and compare
+// the same on every compiler.
+//
+// Checkmates are scored past every evaluation, closer to MATE the fewer
+// plies it takes, so that the search prefers the shortest mate and the
+// longest defence.
+//
+// Relavant Docs:
+// https://www.chessprogramming.org/Score
+// https://www.chessprogramming.org/Checkmate#MateScore
+//
+namespace chess {
+
+using Score = int32_t;
+
+namespace scores {
+
+constexpr Score MATE = 1000000000;
+// Wider than any score, for the initial window
+constexpr Score INFINITE = MATE + 1;
+// Scores at least this far from 0 are mates
+constexpr Score MATE_BOUND = MATE - 1024;
+// Static evaluations are clamped below the mates
+constexpr Score MAX_EVAL = MATE_BOUND - 1;
+
+constexpr Score mated_in(int ply) { return -MATE + ply; }
+constexpr bool is_mate(Score s) { return s >= MATE_BOUND || s <= -MATE_BOUND; }
+// Plies to the mate (from the root) of a mate score
+constexpr int mate_plies(Score s) { return MATE - (s > 0 ? s : -s); }
+
+constexpr Score clamp_eval(int64_t v) { return (Score)std::clamp<int64_t>(v, -MAX_EVAL, MAX_EVAL); }
+
+// A number of pawns, for an agent whose pawn is worth pawn
+constexpr Score from_pawns(float pawns, Score pawn) {
+  double v = (double)pawns * pawn;
+  return clamp_eval((int64_t)(v >= 0 ? v + 0.5 : v - 0.5));
+}
+
+//
+// Mate scores count plies from the root, but a table entry may be read
+// at a different ply than the one it was stored from, so the table keeps
+// them relative to the node instead
+//
+constexpr Score to_table(Score s, int ply) {
+  return s >= MATE_BOUND ? s + ply : s <= -MATE_BOUND ? s - ply : s;
+}
+constexpr Score from_table(Score s, int ply) {
+  return s >= MATE_BOUND ? s - ply : s <= -MATE_BOUND ? s + ply : s;
+}
+
+}; // namespace scores
+
+}; // namespace chess
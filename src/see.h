@@ -0,0 +1,116 @@
+#pragma once
+#include "./evaluate.h"
+#include "./game.h"
+#include "./magic/moves.h"
+#include <algorithm>
+#include <array>
+
+/*
+ * Static exchange evaluation
+ *
+ * Plays out every capture on the target square of a move, each side always
+ * recapturing with its least valuable piece, and either side free to stop
+ * capturing when that suits it better. The result is the material the
+ * moving team wins (or loses, when negative) without searching anything.
+ *
+ * Sliders hidden behind a capturing piece join in once it has moved away
+ * (x-rays), their attacks are looked up again with the updated occupancy.
+ * Pins and checks are ignored, like everywhere else in the move ordering.
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/Static_Exchange_Evaluation
+ * https://www.chessprogramming.org/SEE_-_The_Swap_Algorithm
+ *
+ * */
+namespace chess::see {
+
+// The material the moving team wins with the exchanges the move starts,
+// in the units of values
+inline float evaluate(const Game &game, const Game::Move &move, const evaluators::PerPiece &values) {
+  auto &p = game.positions;
+  Bitboard target = move.target_pos;
+  Bitboard occupied = (p.whites | p.blacks) ^ move.source_pos;
+
+  // gain[d] is what the capture at depth d wins, if the exchange ends there
+  std::array<float, 32> gain;
+  gain[0] = 0;
+  if (move.kind == Game::Move::Enpassant) {
+    gain[0] = values.pawn;
+    occupied ^= move.piece->team == Game::Team::White ? target.down() : target.up();
+  } else if (target & occupied)
+    gain[0] = values.of(game.fetch_piece(target)->kind);
+
+  // Value of the piece standing on target, which the next capture takes
+  float standing = values.of(move.piece->kind);
+  if (move.kind == Game::Move::PromoteQueen) {
+    gain[0] += values.queen - values.pawn;
+    standing = values.queen;
+  }
+
+  Bitboard attacking = game.attackers_to(target, occupied);
+  Bitboard diagonal_sliders = p.bishops | p.queens;
+  Bitboard straight_sliders = p.rooks | p.queens;
+  auto team = move.piece->team == Game::Team::White ? Game::Team::Black : Game::Team::White;
+
+  constexpr std::array<Game::PieceKind, 6> CHEAPEST_FIRST = {
+      Game::PieceKind::Pawn, Game::PieceKind::Knight, Game::PieceKind::Bishop,
+      Game::PieceKind::Rook, Game::PieceKind::Queen,  Game::PieceKind::King,
+  };
+  auto pieces_of = [&](Game::PieceKind kind) -> Bitboard {
+    switch (kind) {
+    case Game::PieceKind::Pawn:
+      return p.pawns;
+    case Game::PieceKind::Knight:
+      return p.knights;
+    case Game::PieceKind::Bishop:
+      return p.bishops;
+    case Game::PieceKind::Rook:
+      return p.rooks;
+    case Game::PieceKind::Queen:
+      return p.queens;
+    default:
+      return p.kings;
+    }
+  };
+
+  int d = 0;
+  while (d + 1 < (int)gain.size()) {
+    Bitboard ours = attacking & (team == Game::Team::White ? p.whites : p.blacks);
+    if (!ours)
+      break;
+
+    Bitboard from;
+    Game::PieceKind kind = Game::PieceKind::King;
+    for (auto k : CHEAPEST_FIRST) {
+      if (Bitboard candidates = ours & pieces_of(k)) {
+        from = Bitboard(1ULL << candidates.trailing_zeroes());
+        kind = k;
+        break;
+      }
+    }
+    // The king may only take the last attacker
+    if (kind == Game::PieceKind::King && (attacking & ~ours))
+      break;
+
+    d++;
+    gain[d] = standing - gain[d - 1];
+
+    standing = values.of(kind);
+    occupied ^= from;
+    if (kind == Game::PieceKind::Pawn || kind == Game::PieceKind::Bishop || kind == Game::PieceKind::Queen)
+      attacking |= Bitboard(Bmagic(target.trailing_zeroes(), (uint64_t)occupied)) & diagonal_sliders;
+    if (kind == Game::PieceKind::Rook || kind == Game::PieceKind::Queen)
+      attacking |= Bitboard(Rmagic(target.trailing_zeroes(), (uint64_t)occupied)) & straight_sliders;
+    attacking &= occupied;
+    team = team == Game::Team::White ? Game::Team::Black : Game::Team::White;
+  }
+
+  // Each side only takes when it does better than stopping
+  while (d > 0) {
+    gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    d--;
+  }
+  return gain[0];
+}
+
+}; // namespace chess::see
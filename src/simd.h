@@ -0,0 +1,9 @@
+#pragma once
+
+// Kernels get AVX-512 and AVX2 clones next to the default one, picked once
+// when the library loads (function multi-versioning needs ifunc support)
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__)
+#define SIMD_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SIMD_KERNEL
+#endif
@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Counters collected by the search, to tune it and to spot
+ * performance regressions
+ *
+ * Every search thread counts into its own SearchStats, the totals of a
+ * search are summed over all of them. Per iteration numbers only come from
+ * the main thread, as the helpers don't iterate in step with it.
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/Node_Types
+ * https://www.chessprogramming.org/Branching_Factor
+ *
+ * */
+namespace chess {
+
+struct SearchStats {
+  // Every node visited, quiescence nodes included
+  uint64_t nodes = 0;
+  uint64_t qnodes = 0;
+
+  uint64_t tt_probes = 0;
+  uint64_t tt_hits = 0;
+  // Hits which ended the node without searching it
+  uint64_t tt_cutoffs = 0;
+
+  uint64_t beta_cutoffs = 0;
+  // Beta cutoffs caused by the first move searched, a measure
+  // of how good the move ordering is
+  uint64_t first_move_cutoffs = 0;
+
+  uint64_t eval_probes = 0;
+  uint64_t eval_hits = 0;
+  uint64_t pawn_probes = 0;
+  uint64_t pawn_hits = 0;
+  // Leaves evaluated with a window, and those of them the
+  // cheap terms decided alone (see Weighted::leaf_eval)
+  uint64_t lazy_probes = 0;
+  uint64_t lazy_exits = 0;
+
+  // Deepest ply reached, quiescence included
+  int seldepth = 0;
+
+  SearchStats &operator+=(const SearchStats &o) {
+    nodes += o.nodes;
+    qnodes += o.qnodes;
+    tt_probes += o.tt_probes;
+    tt_hits += o.tt_hits;
+    tt_cutoffs += o.tt_cutoffs;
+    beta_cutoffs += o.beta_cutoffs;
+    first_move_cutoffs += o.first_move_cutoffs;
+    eval_probes += o.eval_probes;
+    eval_hits += o.eval_hits;
+    pawn_probes += o.pawn_probes;
+    pawn_hits += o.pawn_hits;
+    lazy_probes += o.lazy_probes;
+    lazy_exits += o.lazy_exits;
+    seldepth = std::max(seldepth, o.seldepth);
+    return *this;
+  }
+
+  // Counters accumulated since `before` (the seldepth is kept as is)
+  SearchStats since(const SearchStats &before) const {
+    auto d = *this;
+    d.nodes -= before.nodes;
+    d.qnodes -= before.qnodes;
+    d.tt_probes -= before.tt_probes;
+    d.tt_hits -= before.tt_hits;
+    d.tt_cutoffs -= before.tt_cutoffs;
+    d.beta_cutoffs -= before.beta_cutoffs;
+    d.first_move_cutoffs -= before.first_move_cutoffs;
+    d.eval_probes -= before.eval_probes;
+    d.eval_hits -= before.eval_hits;
+    d.pawn_probes -= before.pawn_probes;
+    d.pawn_hits -= before.pawn_hits;
+    d.lazy_probes -= before.lazy_probes;
+    d.lazy_exits -= before.lazy_exits;
+    return d;
+  }
+
+  double tt_hit_rate() const {
+    return tt_probes ? (double)tt_hits / tt_probes : 0;
+  }
+  double eval_hit_rate() const {
+    return eval_probes ? (double)eval_hits / eval_probes : 0;
+  }
+  double pawn_hit_rate() const {
+    return pawn_probes ? (double)pawn_hits / pawn_probes : 0;
+  }
+  double lazy_exit_rate() const {
+    return lazy_probes ? (double)lazy_exits / lazy_probes : 0;
+  }
+  double first_move_cutoff_rate() const {
+    return beta_cutoffs ? (double)first_move_cutoffs / beta_cutoffs : 0;
+  }
+
+  std::string json() const {
+    std::ostringstream out;
+    out << "\"nodes\":" << nodes << ",\"qnodes\":" << qnodes
+        << ",\"tt_probes\":" << tt_probes << ",\"tt_hits\":" << tt_hits
+        << ",\"tt_cutoffs\":" << tt_cutoffs
+        << ",\"tt_hit_rate\":" << tt_hit_rate()
+        << ",\"beta_cutoffs\":" << beta_cutoffs
+        << ",\"first_move_cutoffs\":" << first_move_cutoffs
+        << ",\"first_move_cutoff_rate\":" << first_move_cutoff_rate()
+        << ",\"eval_probes\":" << eval_probes
+        << ",\"eval_hits\":" << eval_hits
+        << ",\"eval_hit_rate\":" << eval_hit_rate()
+        << ",\"pawn_probes\":" << pawn_probes
+        << ",\"pawn_hits\":" << pawn_hits
+        << ",\"pawn_hit_rate\":" << pawn_hit_rate()
+        << ",\"lazy_probes\":" << lazy_probes
+        << ",\"lazy_exits\":" << lazy_exits
+        << ",\"lazy_exit_rate\":" << lazy_exit_rate()
+        << ",\"seldepth\":" << seldepth;
+    return out.str();
+  }
+};
+
+//
+// One completed iteration of iterative deepening (main thread only)
+//
+struct IterationStats {
+  int depth = 0;
+  int64_t time_ms = 0;
+  SearchStats stats;
+  // Nodes of this iteration over the nodes of the previous one
+  double branching_factor = 0;
+
+  std::string json() const {
+    std::ostringstream out;
+    out << "{\"depth\":" << depth << ",\"time_ms\":" << time_ms
+        << ",\"branching_factor\":" << branching_factor << "," << stats.json()
+        << "}";
+    return out.str();
+  }
+};
+
+}; // namespace chess
@@ -1,6 +1,12 @@
 #pragma once
 #include "./game.h"
 #include "./agents/weighted.h"
+#include "./batch.h"
+#include "./cmaes.h"
+#include "./dataset.h"
+#include<numeric>
+#include<random>
+#include<span>
 #include<thread>
 
 struct WAgent : agents::Weighted
@@ -56,6 +62,9 @@ WAgent generate_random_weighted_agent()
     wgt.weights.check = generate_random_multistage_eval_weight();
     wgt.weights.center_control = generate_random_multistage_eval_weight();
     wgt.weights.protected_pieces = generate_random_multistage_eval_weight();
+    wgt.weights.passed_pawns = generate_random_multistage_eval_weight();
+    wgt.weights.isolated_pawns = generate_random_multistage_eval_weight();
+    wgt.weights.doubled_pawns = generate_random_multistage_eval_weight();
 
     wgt.weights.positions = generate_random_perpiece_eval_weight(100);
     wgt.weights.values = generate_random_perpiece_eval_weight(10000);
@@ -79,13 +88,6 @@ const auto processor_count = std::thread::hardware_concurrency();
 
 #include <fstream>
 
-enum Result
-{
-    WhiteWin,
-    BlackWin,
-    Draw,
-};
-
 int rand_weighted(std::vector<float> weights)
 {
     float accum = 0;
@@ -110,23 +112,13 @@ int rand_weighted(std::vector<float> weights)
     exit(1);
 }
 
-std::map<std::string, Result> read_tuner_data()
+// The converted dataset (see dataset.h) when there is one, as
+// the positions are otherwise parsed from their FENs on every start
+dataset::Reader read_tuner_data()
 {
-    std::fstream data("../tuner_positions.txt");
-    std::map<std::string, Result> ret;
-    for (std::string line; getline(data, line);)
-    {
-        auto split = line.find("[");
-        auto fen = line.substr(0, split - 1);
-        auto num = line.substr(split);
-        if (num == "[0.0]")
-            ret[fen] = BlackWin;
-        else if (num == "[0.5]")
-            ret[fen] = Draw;
-        else
-            ret[fen] = WhiteWin;
-    }
-    return ret;
+    if (std::ifstream("../tuner_positions.bin"))
+        return dataset::Reader("../tuner_positions.bin");
+    return dataset::Reader(dataset::parse("../tuner_positions.txt"));
 }
 
 std::vector<WAgent> create_agents(int n)
@@ -215,54 +207,105 @@ std::vector<WAgent> generate_children(std::vector<WAgent> parents, int n)
     return ret;
 }
 
-void populate_agent_score(WAgent &ag, std::map<std::string, Result> &dataset)
+//
+// The dataset, with the terms of every position extracted once up front
+// (see batch.h), so that scoring an agent only has to weigh them
+//
+struct TrainingSet
+{
+    batch::Positions positions;
+    batch::Features features;
+    std::vector<Result> results;
+    // Positions from the first moves, which every agent is given
+    int openings = 0;
+    size_t total = 0;
+};
+
+// Shuffled, any consecutive range of the set is a random sample of it
+TrainingSet extract_training_set(const dataset::Reader &dataset, bool shuffle = false)
 {
-    int cnt = 0;
-    for (auto g : dataset)
+    TrainingSet set;
+    set.total = dataset.size();
+    set.positions.reserve(dataset.size());
+    set.results.reserve(dataset.size());
+
+    std::vector<size_t> order(dataset.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (shuffle)
+        std::shuffle(order.begin(), order.end(), std::mt19937(rand()));
+    for (auto i : order)
     {
-        auto fen = g.first;
-        auto res = g.second;
-        auto game = Game::create(fen);
+        auto &position = dataset[i];
+        auto game = position.unpack();
         if (game.fullmoves < 5)
         {
-            cnt++;
+            set.openings++;
             continue;
         }
+        set.positions.push(game);
+        set.results.push_back(position.result());
+    }
+    batch::extract(set.positions, set.features);
+    return set;
+}
 
-        auto my_eval = ag.weightedsum(game, game.current_active_team());
-        auto enemy_eval = ag.weightedsum(game, game.current_active_team() == Game::Team::White ? Game::Team::Black : Game::Team::White);
+// Whether the evaluations of the team to move and its enemy agree with the result
+bool correct_guess(float my_eval, float enemy_eval, Game::Team to_move, Result res)
+{
+    if(to_move == Game::Team::White){
+        if(my_eval > enemy_eval && res == WhiteWin)return true;
+        else if(my_eval < enemy_eval && res == BlackWin)return true;
+    }
+    else{
+        if(my_eval > enemy_eval && res == BlackWin)return true;
+        else if(my_eval < enemy_eval && res == WhiteWin)return true;
+    }
+    if (res == Draw)
+    {
+        auto diff = my_eval - enemy_eval;
+        auto avg = (my_eval + enemy_eval) / 2;
+        if (diff < 0)
+            diff = -diff;
+        // 10% threshold
+        if (diff < (avg / 10))
+            return true;
+    }
+    return false;
+}
 
-        if(game.current_active_team() == Game::Team::White){
-            if(my_eval > enemy_eval && res == WhiteWin)cnt++;
-            else if(my_eval < enemy_eval && res == BlackWin)cnt++;
-        }
-        else{
-            if(my_eval > enemy_eval && res == BlackWin)cnt++;
-            else if(my_eval < enemy_eval && res == WhiteWin)cnt++;
-        }
-        if (res == Draw)
+// Scores every agent a block of positions at a time, so that
+// the block's features are read from memory once for all of them
+void populate_agent_scores(std::span<WAgent> agents, const TrainingSet &set)
+{
+    std::vector<int> counts(agents.size(), set.openings);
+    std::array<float, batch::BLOCK> white, black;
+    for (size_t begin = 0; begin < set.results.size(); begin += batch::BLOCK)
+    {
+        auto end = std::min(begin + batch::BLOCK, set.results.size());
+        for (size_t a = 0; a < agents.size(); a++)
         {
-            auto diff = my_eval - enemy_eval;
-            auto avg = (my_eval + enemy_eval) / 2;
-            if (diff < 0)
-                diff = -diff;
-            // 10% threshold
-            if (diff < (avg / 10))
-                cnt++;
+            batch::weightedsums(set.positions, set.features, agents[a].weights, begin, end, white.data(), black.data());
+            for (size_t i = begin; i < end; i++)
+            {
+                auto to_move = (Game::Team)set.positions.to_move[i];
+                auto ours = to_move == Game::Team::White ? white[i - begin] : black[i - begin];
+                auto theirs = to_move == Game::Team::White ? black[i - begin] : white[i - begin];
+                counts[a] += correct_guess(ours, theirs, to_move, set.results[i]);
+            }
         }
     }
-    ag.score = (float)cnt / (float)dataset.size();
+    for (size_t a = 0; a < agents.size(); a++)
+    {
+        agents[a].score = (float)counts[a] / (float)set.total;
+    }
 }
 
-void populate_agent_scores(std::vector<WAgent> &agents, std::map<std::string, Result> &dataset)
+void populate_agent_score(WAgent &ag, const TrainingSet &set)
 {
-    for (auto &ag : agents)
-    {
-        populate_agent_score(ag, dataset);
-    }
+    populate_agent_scores(std::span(&ag, 1), set);
 }
 
-std::vector<WAgent> top_agents(std::vector<WAgent> agents, int n, std::map<std::string, Result> &dataset)
+std::vector<WAgent> top_agents(std::vector<WAgent> agents, int n, const TrainingSet &dataset)
 {
 
     auto worker_count = processor_count > 2 ? processor_count - 2 : 1;
@@ -277,7 +320,7 @@ std::vector<WAgent> top_agents(std::vector<WAgent> agents, int n, std::map<std::
         auto end = worker_agent_count * (i + 1);
         auto workload = std::vector<WAgent>(agents.begin() + start, agents.begin() + end);
         workloads.push_back(workload);
-        std::thread th(populate_agent_scores, std::ref(workloads[i]), std::ref(dataset));
+        std::thread th([&workload = workloads[i], &dataset]() { populate_agent_scores(workload, dataset); });
         // auto res = std::async(populate_agent_scores, std::ref(workloads[i]), std::ref(dataset));
         futures.push_back(std::move(th));
     }
@@ -325,7 +368,7 @@ void trainify()
     
     std::getline(std::cin, specfile);
 
-    auto data = read_tuner_data();
+    auto data = extract_training_set(read_tuner_data());
     srand(time(0));
 
     auto timestamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
@@ -398,4 +441,398 @@ void trainify()
 
         agents = next_generation;
     }
-}
\ No newline at end of file
+}
+
+///////////////////////
+////// GRADIENT TUNER
+///////////////////////
+//
+// Texel's tuning method: instead of evolving agents by how often they guess
+// the result, the weights are moved down the gradient of the logistic loss
+// between the evaluation and the result of every position
+//
+//   loss = -(R log(sigmoid(K eval)) + (1 - R) log(1 - sigmoid(K eval)))
+//
+// where R is 1, 0.5 or 0 for a white win, a draw and a black win, and eval
+// is white's weighted sum minus black's. K is fitted to the initial weights
+// once and then kept, which pins down the overall scale of the weights.
+//
+// The gradient is taken by central differences over the weighing kernels
+// of batch.h, so it follows the evaluator exactly (truncations included).
+// A minibatch is split between the worker threads, and the steps are
+// Adam's, in units of each weight's initial magnitude.
+//
+// Relavant Docs:
+// https://www.chessprogramming.org/Texel%27s_Tuning_Method
+//
+
+const int TUNE_EPOCHS = 100;
+const size_t TUNE_BATCH = 16384;
+const float TUNE_LEARNING_RATE = 0.01;
+// Positions held out to decide when to stop
+const float TUNE_VALIDATION = 0.1;
+// Epochs without improvement on the held out positions before stopping
+const int TUNE_PATIENCE = 5;
+
+// Every weight the tuner adjusts
+std::vector<float *> tunable_weights(agents::Weighted::EvaluatorWeights &w)
+{
+    std::vector<float *> ret;
+    for (auto *m : {&w.check, &w.mobility, &w.vulnerability, &w.pawn_devel, &w.positioning, &w.material,
+                    &w.king_front_pawns, &w.center_control, &w.protected_pieces, &w.passed_pawns,
+                    &w.isolated_pawns, &w.doubled_pawns})
+    {
+        ret.insert(ret.end(), {&m->opening, &m->midgame, &m->endgame});
+    }
+    for (auto *p : {&w.positions, &w.values})
+    {
+        ret.insert(ret.end(), {&p->king, &p->queen, &p->rook, &p->bishop, &p->knight, &p->pawn});
+    }
+    return ret;
+}
+
+// Summed loss of the positions [begin, end)
+double texel_loss(const TrainingSet &set, const agents::Weighted::EvaluatorWeights &weights, double k,
+                  size_t begin, size_t end)
+{
+    std::array<float, batch::BLOCK> white, black;
+    double loss = 0;
+    for (size_t from = begin; from < end; from += batch::BLOCK)
+    {
+        auto to = std::min(from + batch::BLOCK, end);
+        batch::weightedsums(set.positions, set.features, weights, from, to, white.data(), black.data());
+        for (size_t i = from; i < to; i++)
+        {
+            double z = k * ((double)white[i - from] - black[i - from]);
+            if (!std::isfinite(z))
+                continue;
+            double r = set.results[i] == WhiteWin ? 1 : set.results[i] == Draw ? 0.5 : 0;
+            // log(1 + e^z) - R z, without overflowing
+            loss += std::max(z, 0.0) + std::log1p(std::exp(-std::abs(z))) - r * z;
+        }
+    }
+    return loss;
+}
+
+// Loss of the positions [begin, end), split between the worker threads
+double texel_loss_parallel(const TrainingSet &set, const agents::Weighted::EvaluatorWeights &weights,
+                           double k, size_t begin, size_t end)
+{
+    auto workers = std::max(1u, processor_count);
+    std::vector<double> losses(workers);
+    std::vector<std::thread> threads;
+    auto slice = (end - begin + workers - 1) / workers;
+    for (unsigned t = 0; t < workers; t++)
+    {
+        auto from = std::min(begin + t * slice, end);
+        auto to = std::min(from + slice, end);
+        threads.emplace_back([&, t, from, to]() { losses[t] = texel_loss(set, weights, k, from, to); });
+    }
+    for (auto &th : threads)
+    {
+        th.join();
+    }
+    return std::accumulate(losses.begin(), losses.end(), 0.0);
+}
+
+// The K which fits the weights best, searched on a log scale
+double fit_texel_k(const TrainingSet &set, const agents::Weighted::EvaluatorWeights &weights, size_t end)
+{
+    auto loss = [&](double log_k) { return texel_loss_parallel(set, weights, std::pow(10.0, log_k), 0, end); };
+    double best = -8;
+    for (double log_k = -8; log_k <= 0; log_k += 0.5)
+    {
+        if (loss(log_k) < loss(best))
+            best = log_k;
+    }
+    // Golden section search around the best of the grid
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double lo = best - 0.5, hi = best + 0.5;
+    for (int i = 0; i < 30; i++)
+    {
+        double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+        if (loss(a) < loss(b))
+            hi = b;
+        else
+            lo = a;
+    }
+    return std::pow(10.0, (lo + hi) / 2);
+}
+
+// Gradient of the summed loss of the positions [begin, end) over
+// the tunable weights, each stepped by its scale
+std::vector<double> texel_gradient(const TrainingSet &set, const agents::Weighted::EvaluatorWeights &weights,
+                                   const std::vector<float> &scales, double k, size_t begin, size_t end)
+{
+    auto workers = std::max(1u, processor_count);
+    auto n = scales.size();
+    std::vector<std::vector<double>> gradients(workers, std::vector<double>(n));
+    std::vector<std::thread> threads;
+    auto slice = (end - begin + workers - 1) / workers;
+    for (unsigned t = 0; t < workers; t++)
+    {
+        auto from = std::min(begin + t * slice, end);
+        auto to = std::min(from + slice, end);
+        threads.emplace_back([&, t, from, to]() {
+            auto w = weights;
+            auto params = tunable_weights(w);
+            for (size_t i = 0; i < n; i++)
+            {
+                auto h = scales[i] * 1e-2f;
+                auto original = *params[i];
+                *params[i] = original + h;
+                auto plus = texel_loss(set, w, k, from, to);
+                *params[i] = original - h;
+                auto minus = texel_loss(set, w, k, from, to);
+                *params[i] = original;
+                // Per unit of scale, which is what Adam steps in
+                gradients[t][i] = (plus - minus) / 2e-2;
+            }
+        });
+    }
+    for (auto &th : threads)
+    {
+        th.join();
+    }
+
+    std::vector<double> gradient(n);
+    for (auto &g : gradients)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            gradient[i] += g[i];
+        }
+    }
+    return gradient;
+}
+
+// Fraction of the positions [begin, end) guessed right, like populate_agent_score
+float texel_accuracy(const TrainingSet &set, const agents::Weighted::EvaluatorWeights &weights, size_t begin,
+                     size_t end)
+{
+    std::array<float, batch::BLOCK> white, black;
+    size_t correct = 0;
+    for (size_t from = begin; from < end; from += batch::BLOCK)
+    {
+        auto to = std::min(from + batch::BLOCK, end);
+        batch::weightedsums(set.positions, set.features, weights, from, to, white.data(), black.data());
+        for (size_t i = from; i < to; i++)
+        {
+            auto to_move = (Game::Team)set.positions.to_move[i];
+            auto ours = to_move == Game::Team::White ? white[i - from] : black[i - from];
+            auto theirs = to_move == Game::Team::White ? black[i - from] : white[i - from];
+            correct += correct_guess(ours, theirs, to_move, set.results[i]);
+        }
+    }
+    return end > begin ? (float)correct / (float)(end - begin) : 0;
+}
+
+//
+// Tune the weights of the agent in specfile (the default agent when empty)
+// against the dataset, and write the best ones found to output
+//
+void texel_tune(const std::string &specfile, const std::string &output)
+{
+    auto agent = specfile.empty() ? agents::Weighted() : agents::Weighted::from_file(specfile);
+    srand(time(0));
+
+    auto set = extract_training_set(read_tuner_data(), true);
+    auto validation = (size_t)(set.results.size() * TUNE_VALIDATION);
+    auto training = set.results.size() - validation;
+    std::cout << "Tuning on " << training << " positions, validating on " << validation << " using "
+              << processor_count << " threads" << std::endl;
+    if (training == 0 || validation == 0)
+    {
+        std::cout << "Not enough positions to tune on" << std::endl;
+        return;
+    }
+
+    auto params = tunable_weights(agent.weights);
+    std::vector<float> scales;
+    for (auto *p : params)
+    {
+        scales.push_back(std::max(std::abs(*p), 1.0f));
+    }
+
+    auto k = fit_texel_k(set, agent.weights, training);
+    auto validation_loss = [&](const agents::Weighted::EvaluatorWeights &w) {
+        return texel_loss_parallel(set, w, k, training, set.results.size()) / validation;
+    };
+    auto best = agent.weights;
+    auto best_loss = validation_loss(best);
+    std::cout << "K = " << k << ", initial validation loss " << best_loss << ", accuracy "
+              << texel_accuracy(set, best, training, set.results.size()) << std::endl;
+
+    // Adam
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    std::vector<double> m(params.size()), v(params.size());
+    int step = 0;
+    int stale = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int epoch = 1; epoch <= TUNE_EPOCHS && stale < TUNE_PATIENCE; epoch++)
+    {
+        for (size_t begin = 0; begin < training; begin += TUNE_BATCH)
+        {
+            auto end = std::min(begin + TUNE_BATCH, training);
+            auto gradient = texel_gradient(set, agent.weights, scales, k, begin, end);
+            step++;
+            for (size_t i = 0; i < params.size(); i++)
+            {
+                auto g = gradient[i] / (double)(end - begin);
+                m[i] = beta1 * m[i] + (1 - beta1) * g;
+                v[i] = beta2 * v[i] + (1 - beta2) * g * g;
+                auto m_hat = m[i] / (1 - std::pow(beta1, step));
+                auto v_hat = v[i] / (1 - std::pow(beta2, step));
+                // Every weight is kept positive, the penalties are subtracted instead
+                *params[i] = std::max(0.0, *params[i] - TUNE_LEARNING_RATE * scales[i] * m_hat /
+                                                            (std::sqrt(v_hat) + epsilon));
+            }
+        }
+
+        auto loss = validation_loss(agent.weights);
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Epoch " << epoch << ": validation loss " << loss << ", accuracy "
+                  << texel_accuracy(set, agent.weights, training, set.results.size()) << " (" << elapsed.count()
+                  << "s)" << std::endl;
+        if (loss < best_loss)
+        {
+            best_loss = loss;
+            best = agent.weights;
+            stale = 0;
+            // Written every time, so that stopping early still leaves the best weights
+            std::ofstream(output) << agent.encode();
+        }
+        else
+        {
+            stale++;
+        }
+    }
+
+    agent.weights = best;
+    std::ofstream(output) << agent.encode();
+    std::cout << "Best validation loss " << best_loss << ", weights written to " << output << std::endl;
+}
+
+///////////////////////
+////// CMA-ES
+///////////////////////
+//
+// Optimizes the same fitness as the genetic algorithm (populate_agent_score)
+// with CMA-ES (see cmaes.h), over every tunable weight in units of its
+// initial magnitude. A generation's samples are scored in parallel, and the
+// optimizer's state is written after every generation, so that training
+// resumes where it stopped (given the same initial agent)
+//
+
+const int CMAES_GENERATIONS = 1000;
+const double CMAES_SIGMA = 0.3;
+
+// Score agents split between the worker threads
+void populate_agent_scores_parallel(std::vector<WAgent> &agents, const TrainingSet &set)
+{
+    auto worker_count = std::min<size_t>(std::max(1u, processor_count), agents.size());
+    auto slice = (agents.size() + worker_count - 1) / worker_count;
+    std::vector<std::thread> threads;
+    for (size_t begin = 0; begin < agents.size(); begin += slice)
+    {
+        auto part = std::span(agents).subspan(begin, std::min(slice, agents.size() - begin));
+        threads.emplace_back([part, &set]() { populate_agent_scores(part, set); });
+    }
+    for (auto &th : threads)
+    {
+        th.join();
+    }
+}
+
+void cmaes_train(const std::string &specfile, const std::string &state)
+{
+    WAgent initial = specfile.empty() ? agents::Weighted() : agents::Weighted::from_file(specfile);
+
+    auto params = tunable_weights(initial.weights);
+    // The optimizer works on the weights divided by their starting magnitude
+    std::vector<double> scales;
+    std::vector<double> start;
+    for (auto *p : params)
+    {
+        scales.push_back(std::max(std::abs(*p), 1.0f));
+        start.push_back(*p / scales.back());
+    }
+
+    bool resumed = (bool)std::ifstream(state);
+    auto optimizer = resumed ? cmaes::Optimizer::load(state) : cmaes::Optimizer(start, CMAES_SIGMA);
+    // A state saved for another set of weights (an older build) can't be resumed,
+    // nor one started from another agent, its coordinates are in other units
+    if (optimizer.mean().size() != params.size())
+        throw chess::Error("CMA-ES state " + state + " has " + std::to_string(optimizer.mean().size()) +
+                           " weights, the agent has " + std::to_string(params.size()));
+    if (!resumed)
+        optimizer.set_scales(scales);
+    else if (optimizer.scales() != scales)
+        throw chess::Error("CMA-ES state " + state + " was started from another agent, resume it with that one");
+
+    auto data = extract_training_set(read_tuner_data());
+    populate_agent_score(initial, data);
+
+    auto timestamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::ofstream logfile("CMA-ES Log " + std::to_string(timestamp));
+    logfile << "CMA-ES Training Log @ " << timestamp << "\n";
+    logfile << (resumed ? "Resumed from " : "Starting, state in ") << state << " at generation "
+            << optimizer.generation() << "\n";
+    logfile << "Samples per Generation: " << optimizer.population() << "\n";
+    logfile << "Initial agent score: " << initial.score << "\n";
+
+    WAgent best = initial;
+    if (resumed && std::ifstream(state + ".agent"))
+    {
+        best = agents::Weighted::from_file(state + ".agent");
+        populate_agent_score(best, data);
+    }
+    long evaluations = 0;
+    while (optimizer.generation() < CMAES_GENERATIONS && optimizer.sigma() > 1e-8)
+    {
+        // The weights are kept positive like mutate does, by their magnitude
+        auto &samples = optimizer.ask();
+        std::vector<WAgent> agents(samples.size(), initial);
+        for (size_t k = 0; k < samples.size(); k++)
+        {
+            auto weights = tunable_weights(agents[k].weights);
+            for (size_t i = 0; i < weights.size(); i++)
+            {
+                *weights[i] = std::abs(samples[k][i]) * scales[i];
+            }
+        }
+        populate_agent_scores_parallel(agents, data);
+        evaluations += agents.size();
+
+        std::vector<double> fitness;
+        float mean = 0;
+        for (auto &ag : agents)
+        {
+            fitness.push_back(ag.score);
+            mean += ag.score / agents.size();
+        }
+        auto top = *std::max_element(agents.begin(), agents.end());
+        if (top.score > best.score)
+        {
+            best = top;
+            std::ofstream(state + ".agent") << best.encode();
+        }
+        optimizer.tell(fitness);
+        optimizer.save(state);
+
+        std::cout << "Generation " << optimizer.generation() << ": best " << top.score << " (overall "
+                  << best.score << "), mean " << mean << ", sigma " << optimizer.sigma() << ", axis ratio "
+                  << optimizer.axis_ratio() << ", " << evaluations << " evaluations" << std::endl;
+        logfile << "Generation " << optimizer.generation() << "\n";
+        logfile << "Best Score: " << top.score << "\n";
+        logfile << "Mean Score: " << mean << "\n";
+        logfile << "Sigma: " << optimizer.sigma() << "\n";
+        logfile << "Axis Ratio: " << optimizer.axis_ratio() << "\n";
+        logfile << "Evaluations: " << evaluations << "\n";
+        logfile.flush();
+    }
+    logfile << "Best Agent:\n" << best.encode() << "\n";
+    std::ofstream(state + ".agent") << best.encode();
+    std::cout << "Best score " << best.score << ", weights written to " << state << ".agent" << std::endl;
+}
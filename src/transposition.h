@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include "./hashtable.h"
+#include "./score.h"
+
+//
+// Relavant Docs:
+// https://www.chessprogramming.org/Transposition_Table
+//
+// The table is shared between every search thread, lock-less (see hashtable.h)
+//
+namespace chess {
+
+class TranspositionTable : public LocklessTable<TranspositionTable> {
+public:
+  enum NodeType : uint8_t {
+    Empty,
+    Exact,
+    Lowerbound, // Fail High (score >= beta)
+    Upperbound, // Fail Low  (score <= alpha)
+  };
+
+  struct Entry {
+    // Mate scores are relative to the node, see scores::to_table
+    Score evaluation = 0;
+    uint8_t depth = 0;
+    NodeType type = Empty;
+    // Best move found at this node, see Game::Move::packed()
+    uint16_t move = 0;
+  };
+
+  explicit TranspositionTable(size_t megabytes = 16) : LocklessTable(megabytes) {}
+
+  bool probe(uint64_t key, Entry &out) const { return LocklessTable::probe(key, out) && out.type != Empty; }
+
+  void store(uint64_t key, Entry e) {
+    // Depth-preferred replacement, a different position always gets
+    // replaced, as it is most likely stale
+    Entry old;
+    if (LocklessTable::probe(key, old) && old.depth > e.depth)
+      return;
+    LocklessTable::store(key, e);
+  }
+
+private:
+  friend LocklessTable;
+
+  // LAYOUT:
+  // [ 0..31] evaluation
+  // [32..39] depth
+  // [40..47] node type
+  // [48..63] best move
+  static uint64_t pack(Entry e) {
+    return (uint64_t)(uint32_t)e.evaluation |
+           ((uint64_t)e.depth << 32) | ((uint64_t)e.type << 40) |
+           ((uint64_t)e.move << 48);
+  }
+  static Entry unpack(uint64_t data) {
+    Entry e;
+    e.evaluation = (Score)(uint32_t)data;
+    e.depth = (data >> 32) & 0xFF;
+    e.type = (NodeType)((data >> 40) & 0xFF);
+    e.move = data >> 48;
+    return e;
+  }
+
+};
+
+}; // namespace chess
@@ -0,0 +1,319 @@
+#pragma once
+#include "./game.h"
+#include "./agents/weighted.h"
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/*
+ * Universal Chess Interface front-end
+ *
+ * Lets the engine be driven by tournament managers and analysis GUIs
+ * (`chess` without arguments, or `chess uci`). Commands are read from
+ * stdin, while the search runs on its own thread so that `stop`,
+ * `ponderhit` and `isready` are answered during it.
+ *
+ * Supported:
+ *   uci, isready, ucinewgame, quit
+ *   setoption name Hash|Threads value <n>
+ *   position [startpos | fen <fen>] [moves <move>...]
+ *   go [depth <n>] [movetime <ms>] [wtime|btime|winc|binc <ms>]
+ *      [movestogo <n>] [nodes <n>] [infinite] [ponder]
+ *   stop, ponderhit
+ *
+ * Relavant Docs:
+ * https://www.chessprogramming.org/UCI
+ * https://www.wbec-ridderkerk.nl/html/UCIProtocol.html
+ *
+ * */
+namespace chess {
+
+class Uci {
+public:
+  using Weighted = agents::Weighted;
+
+  static constexpr const char *STARTPOS =
+      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  Uci() : m_agent(Weighted::production()), m_position(Game::create(STARTPOS)) {
+    m_control.on_iteration = [this](const Weighted::SearchResult &r) {
+      report(r);
+    };
+  }
+  ~Uci() { stop(); }
+
+  void run(std::istream &in = std::cin) {
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream cmd(line);
+      std::string token;
+      cmd >> token;
+
+      if (token == "uci") {
+        send("id name chess");
+        send("id author chess contributors");
+        send("option name Hash type spin default " +
+             std::to_string(m_agent.hash_size) + " min 1 max 4096");
+        send("option name Threads type spin default " +
+             std::to_string(m_agent.threads) + " min 1 max 256");
+        send("option name Ponder type check default false");
+        send("uciok");
+      } else if (token == "isready")
+        send("readyok");
+      else if (token == "ucinewgame") {
+        stop();
+        m_agent.table().clear();
+        m_agent.eval_table().clear();
+        m_agent.pawn_table().clear();
+      } else if (token == "setoption")
+        setoption(cmd);
+      else if (token == "position")
+        position(cmd);
+      else if (token == "go")
+        go(cmd);
+      else if (token == "stop")
+        stop();
+      else if (token == "ponderhit")
+        ponderhit();
+      else if (token == "quit")
+        break;
+    }
+    stop();
+  }
+
+private:
+  // Limits of a `go` command
+  struct Limits {
+    int depth = 0;
+    uint64_t nodes = 0;
+    int64_t movetime = 0;
+    int64_t time[2] = {0, 0}; // indexed by Game::Team
+    int64_t inc[2] = {0, 0};
+    int movestogo = 0;
+    bool infinite = false;
+    bool ponder = false;
+  };
+
+  void send(const std::string &line) {
+    std::lock_guard lock(m_io);
+    std::cout << line << std::endl;
+  }
+
+  void setoption(std::istringstream &cmd) {
+    std::string token, name, value;
+    cmd >> token; // name
+    while (cmd >> token && token != "value")
+      name += (name.empty() ? "" : " ") + token;
+    cmd >> value;
+
+    if (name != "Hash" && name != "Threads")
+      return;
+    int n;
+    auto [end, err] = std::from_chars(value.data(), value.data() + value.size(), n);
+    if (err != std::errc() || end != value.data() + value.size()) {
+      send("info string invalid value " + value + " for " + name);
+      return;
+    }
+
+    stop();
+    if (name == "Hash") {
+      m_agent.hash_size = std::max(1, n);
+      m_agent.table().resize(m_agent.hash_size);
+    } else
+      m_agent.threads = std::max(1, n);
+  }
+
+  void position(std::istringstream &cmd) {
+    std::string token, fen;
+    cmd >> token;
+    if (token == "startpos") {
+      fen = STARTPOS;
+      cmd >> token; // moves
+    } else if (token == "fen") {
+      while (cmd >> token && token != "moves")
+        fen += token + " ";
+    } else
+      return;
+
+    stop();
+    try {
+      m_position = Game::create(fen);
+    } catch (...) {
+      send("info string invalid fen " + fen);
+      return;
+    }
+    while (cmd >> token) {
+      std::optional<Game::Move> move;
+      auto team = m_position->current_active_team();
+      if (m_position->state == Game::State::WhiteToMove ||
+          m_position->state == Game::State::BlackToMove) {
+        for (auto &m : m_position->movelist(team)) {
+          if (Game::Move::packed_str(m.packed()) == token) {
+            move = m;
+            break;
+          }
+        }
+      }
+      if (!move) {
+        send("info string illegal move " + token);
+        return;
+      }
+      m_position->make_move(*move);
+    }
+  }
+
+  void go(std::istringstream &cmd) {
+    Limits limits;
+    std::string token;
+    auto w = (int)Game::Team::White, b = (int)Game::Team::Black;
+    while (cmd >> token) {
+      if (token == "depth")
+        cmd >> limits.depth;
+      else if (token == "nodes")
+        cmd >> limits.nodes;
+      else if (token == "movetime")
+        cmd >> limits.movetime;
+      else if (token == "wtime")
+        cmd >> limits.time[w];
+      else if (token == "btime")
+        cmd >> limits.time[b];
+      else if (token == "winc")
+        cmd >> limits.inc[w];
+      else if (token == "binc")
+        cmd >> limits.inc[b];
+      else if (token == "movestogo")
+        cmd >> limits.movestogo;
+      else if (token == "infinite")
+        limits.infinite = true;
+      else if (token == "ponder")
+        limits.ponder = true;
+    }
+
+    stop();
+    m_limits = limits;
+    m_team = m_position->current_active_team();
+    m_control.stop = false;
+    m_control.max_nodes = limits.nodes;
+    m_control.deadline = 0;
+    m_holding = limits.infinite || limits.ponder;
+
+    bool bounded = limits.nodes || limits.movetime || limits.time[w] ||
+                   limits.time[b] || limits.infinite || limits.ponder;
+    if (limits.depth)
+      m_control.max_depth = limits.depth;
+    else
+      m_control.max_depth =
+          bounded ? MoveOrdering::MAX_PLY - 1 : m_agent.search_depth;
+    // While pondering the clock belongs to the opponent
+    if (!limits.ponder)
+      start_clock();
+
+    m_start = Weighted::SearchControl::now();
+    m_pawn_score = std::max(m_agent.pawn_score(m_position->stage), 1);
+    m_searcher = std::thread([this, game = *m_position]() {
+      auto result = m_agent.search(game, m_control);
+
+      // `go infinite` and `go ponder` must not answer before being told to
+      std::unique_lock lock(m_hold_mutex);
+      m_hold.wait(lock, [this]() { return !m_holding; });
+
+      // Stopped before the first iteration, fall back to the best ordered move
+      std::string line = "bestmove ";
+      if (!result.pv.empty())
+        line += Game::Move::packed_str(result.pv[0]);
+      else if (!game.movelist(game.current_active_team()).empty())
+        line += Game::Move::packed_str(result.bestmove.packed());
+      else
+        line += "0000";
+      if (result.pv.size() >= 2)
+        line += " ponder " + Game::Move::packed_str(result.pv[1]);
+      send(line);
+    });
+  }
+
+  // Turn the limits of the current `go` into a deadline
+  void start_clock() {
+    auto budget = m_limits.movetime;
+    auto time = m_limits.time[(int)m_team];
+    if (!budget && time) {
+      auto inc = m_limits.inc[(int)m_team];
+      budget = time / (m_limits.movestogo ? m_limits.movestogo : 30) + inc / 2;
+      // Keep a little in reserve for the communication overhead
+      budget = std::clamp<int64_t>(budget, 1, std::max<int64_t>(time - 50, 1));
+    }
+    if (budget)
+      m_control.set_time_limit(budget);
+  }
+
+  void release() {
+    std::lock_guard lock(m_hold_mutex);
+    m_holding = false;
+    m_hold.notify_all();
+  }
+
+  void stop() {
+    if (!m_searcher.joinable())
+      return;
+    m_control.stop = true;
+    release();
+    m_searcher.join();
+  }
+
+  // The opponent played the expected move, the search goes on as a normal one
+  void ponderhit() {
+    if (!m_searcher.joinable() || !m_limits.ponder)
+      return;
+    m_limits.ponder = false;
+    if (!m_limits.depth && !m_limits.infinite &&
+        !(m_limits.nodes || m_limits.movetime || m_limits.time[0] ||
+          m_limits.time[1]))
+      m_control.max_depth = m_agent.search_depth;
+    start_clock();
+    if (!m_limits.infinite)
+      release();
+  }
+
+  void report(const Weighted::SearchResult &r) {
+    auto elapsed = std::max<int64_t>(Weighted::SearchControl::now() - m_start, 1);
+    std::string score;
+    if (scores::is_mate(r.score)) {
+      int moves = (scores::mate_plies(r.score) + 1) / 2;
+      score = "mate " + std::to_string(r.score > 0 ? moves : -moves);
+    } else
+      score = "cp " + std::to_string((int64_t)r.score * 100 / m_pawn_score);
+
+    int seldepth = r.iterations.empty() ? r.depth : r.iterations.back().stats.seldepth;
+    std::string line = "info depth " + std::to_string(r.depth) + " seldepth " +
+                       std::to_string(seldepth) + " score " +
+                       score + " nodes " + std::to_string(r.nodes) + " nps " +
+                       std::to_string(r.nodes * 1000 / elapsed) + " time " +
+                       std::to_string(elapsed) + " pv";
+    for (auto m : r.pv)
+      line += " " + Game::Move::packed_str(m);
+    send(line);
+  }
+
+  Weighted m_agent;
+  std::optional<Game> m_position;
+  Game::Team m_team = Game::Team::White;
+  Limits m_limits;
+  int64_t m_start = 0;
+  // Scores are reported in hundredths of this (see Weighted::pawn_score)
+  Score m_pawn_score = 100;
+
+  Weighted::SearchControl m_control;
+  std::thread m_searcher;
+
+  std::mutex m_io;
+  std::mutex m_hold_mutex;
+  std::condition_variable m_hold;
+  bool m_holding = false;
+};
+
+}; // namespace chess
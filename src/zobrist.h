@@ -3,6 +3,7 @@
 #include<array>
 #include<random>
 #include<cstdint>
+#include "bitboard.h"
 //
 // Relavant Docs:
 // https://www.chessprogramming.org/Zobrist_Hashing
@@ -67,4 +68,16 @@ namespace chess::zobrist {
     inline Hash enpassant_row7 = rand_hash();
     inline Hash enpassant_row8 = rand_hash();
 
+    // Square of a single piece, as a key index. pos is never empty, the mask
+    // only shows the compiler that the index stays within the key arrays
+    inline uint8_t square_of(Bitboard pos) { return pos.trailing_zeroes() & 63; }
+
+    // Key of a pawn or king, for the pawn structure hash
+    inline Hash pawn_key(Bitboard pos, bool white, bool king) {
+        auto square = square_of(pos);
+        if (king)
+            return white ? white_kings[square] : black_kings[square];
+        return white ? white_pawns[square] : black_pawns[square];
+    }
+
 };
\ No newline at end of file
@@ -3,4 +3,199 @@
 """
 This program is designed to test the chess model
 using the perft system
+
+Every position lists the number of move sequences of each depth, from
+https://www.chessprogramming.org/Perft_Results where it is listed there.
+Positions packed into dataset records (see src/dataset.h) have to unpack
+into the same game, and captures have to come out of the static exchange
+evaluation (see src/see.h) with the material they win.
+Run from the repository root with the library in binaries/ (see find_bin.py)
 """
+
+import math
+import sys
+
+import bindings as chess
+
+
+PERFT_POSITIONS = [
+    # (name, FEN, counts from depth 1)
+    ("initial position",
+     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     [20, 400, 8902, 197281]),
+    ("kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     [48, 2039, 97862, 4085603]),
+    # En passant captures which would uncover a check along the fourth rank
+    ("position 3",
+     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     [14, 191, 2812, 43238, 674624]),
+    ("position 4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     [6, 264, 9467, 422333]),
+    ("position 5",
+     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     [44, 1486, 62379]),
+
+    # EPD, without the move counters
+    ("kiwipete (EPD)",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+     [48, 2039, 97862]),
+
+    # Only the castling rights the FEN lists remain
+    ("castling, all rights",
+     "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1",
+     [26, 568, 13744]),
+    ("castling, some rights",
+     "r3k2r/8/8/8/8/8/8/R3K2R w Kq - 0 1",
+     [25, 525, 12647]),
+    ("castling, no rights",
+     "r3k2r/8/8/8/8/8/8/R3K2R w - - 0 1",
+     [24, 482, 11522]),
+
+    # The en passant square of the FEN, the capture is the 31st move
+    ("en passant, f6",
+     "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+     [31, 707]),
+    ("en passant, d6",
+     "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 3",
+     [31, 704]),
+    ("en passant, none",
+     "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq - 0 3",
+     [30, 678]),
+]
+
+
+def test_perft():
+    failures = 0
+    for name, fen, counts in PERFT_POSITIONS:
+        game = chess.create_game(fen.encode('utf-8'))
+        if not game:
+            print(f"FAIL {name}: could not parse {fen}")
+            failures += 1
+            continue
+        for depth, expected in enumerate(counts, start=1):
+            result = chess.perft(game, depth)
+            if result != expected:
+                print(f"FAIL {name}: perft({depth}) -> {result}, expected {expected}")
+                failures += 1
+                break
+        else:
+            print(f"ok   {name}")
+        chess.delete_game(game)
+    return failures
+
+
+# Positions which have to come back unchanged from a dataset record
+PACKED_POSITIONS = [
+    # 32 pieces
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    # Some of the castling rights, black to move
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq - 3 17",
+    # En passant, for either team
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    "8/2p5/3p4/KP5r/1R2Pp1k/8/6P1/8 b - e3 0 1",
+    # Long games
+    "8/8/4k3/8/2p5/8/B2K4/8 w - - 99 250",
+]
+
+
+def test_packing():
+    failures = 0
+    agent = chess.create_weighted_agent()
+    for fen in PACKED_POSITIONS:
+        game = chess.create_game(fen.encode('utf-8'))
+        packed = chess.repack_game(game)
+        mismatch = []
+        if chess.get_fen(packed) != chess.get_fen(game):
+            mismatch.append(f"fen {chess.get_fen(packed)}")
+        if chess.game_hash(packed) != chess.game_hash(game):
+            mismatch.append("hash")
+        for team in (chess.Team.White, chess.Team.Black):
+            before = chess.evaluate_game(game, team, agent)
+            after = chess.evaluate_game(packed, team, agent)
+            # The evaluation is NaN for a team whose weighted sum is negative
+            if after != before and not (math.isnan(after) and math.isnan(before)):
+                mismatch.append("evaluation")
+                break
+        if chess.perft(packed, 2) != chess.perft(game, 2):
+            mismatch.append("perft")
+        if mismatch:
+            print(f"FAIL {fen}: {', '.join(mismatch)}")
+            failures += 1
+        else:
+            print(f"ok   {fen}")
+        chess.delete_game(packed)
+        chess.delete_game(game)
+    chess.delete_weighted_agent(agent)
+    return failures
+
+
+# King, queen, rook, bishop, knight and pawn, the default weighted agent's
+SEE_VALUES = (4000, 1050, 500, 325, 325, 100)
+# MoveKind in src/api.h
+PROMOTE_QUEEN = 4
+
+SEE_POSITIONS = [
+    # (name, FEN, from, to, material won)
+    ("undefended pawn",
+     "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1", "e5", 100),
+    ("defended pawn taken by a queen",
+     "4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1", "e1", "e5", -950),
+    ("defended pawn taken by a knight",
+     "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3", "e5", -225),
+    # The rook behind joins in once the first one has taken
+    ("rook behind a rook",
+     "4k3/4r3/8/4p3/8/8/4R3/4R1K1 w - - 0 1", "e2", "e5", 100),
+    ("rook behind a rook, none behind",
+     "4k3/4r3/8/4p3/8/8/4R3/6K1 w - - 0 1", "e2", "e5", -400),
+    # The king may only take the last attacker
+    ("king recaptures",
+     "8/8/8/3k4/4p3/5P2/8/K7 w - - 0 1", "f3", "e4", 0),
+    ("king cannot recapture",
+     "8/8/8/3k4/4p3/5P2/8/K3R3 w - - 0 1", "f3", "e4", 100),
+    ("en passant",
+     "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5", "d6", 100),
+    ("en passant, recaptured",
+     "4k3/2p5/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5", "d6", 0),
+    ("promotion, capturing a rook",
+     "3r3k/4P3/8/8/8/8/8/K7 w - - 0 1", "e7", "d8", 1450),
+    ("promotion, recaptured",
+     "3r3k/4P3/8/8/8/8/8/K7 w - - 0 1", "e7", "e8", -100),
+]
+
+
+def square(name):
+    return (ord(name[0]) - ord('a')) + 8 * (int(name[1]) - 1)
+
+
+def test_see():
+    failures = 0
+    for name, fen, origin, destination, expected in SEE_POSITIONS:
+        game = chess.create_game(fen.encode('utf-8'))
+        moves = chess.get_team_moves(game, chess.get_team(game))
+        found = [moves.data[i] for i in range(moves.count)
+                 if chess.move_origin(moves.data[i]) == square(origin)
+                 and chess.move_destination(moves.data[i]) == square(destination)]
+        # Promotions are evaluated as queens
+        found.sort(key=lambda m: chess.move_kind(m) != PROMOTE_QUEEN)
+        if not found:
+            print(f"FAIL {name}: no move {origin}{destination}")
+            failures += 1
+        else:
+            result = chess.move_see(game, found[0], SEE_VALUES)
+            if result != expected:
+                print(f"FAIL {name}: see({origin}{destination}) -> {result}, expected {expected}")
+                failures += 1
+            else:
+                print(f"ok   {name}")
+        for i in range(moves.count):
+            chess.delete_move(moves.data[i])
+        chess.delete_game(game)
+    return failures
+
+
+if __name__ == "__main__":
+    failures = test_perft() + test_packing() + test_see()
+    sys.exit(1 if failures else 0)